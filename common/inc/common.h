@@ -18,11 +18,20 @@
 #define MAX_DPU_RESULTS (1 << 19)
 #define MAX_RESULTS_PER_READ (1 << 10)
 
+/* Size of the reads, each binary is built for one size (see READ_SIZES in host/CMakeLists.txt) */
+#ifndef SIZE_READ
 #define SIZE_READ 120
+#endif
 #define SIZE_SEED 14
 #define SIZE_NEIGHBOUR_IN_BYTES ((SIZE_READ - SIZE_SEED) / 4)
 #define DELTA_NEIGHBOUR(round) ((SIZE_SEED * round) / 4)
 #define SIZE_IN_SYMBOLS(delta) ((SIZE_NEIGHBOUR_IN_BYTES - delta) * 4)
+/*
+ * Delta to apply to the comparisons of a request whose seed is not at the beginning of the read (see dpu_request_t). The
+ * nucleotides before the seed are not compared by the DPUs, the host adding their substitutions to the scores afterwards
+ * (see score_seed_prefix in host/src/processread.c): an insertion or a deletion there is scored as substitutions.
+ */
+#define DELTA_SEED_POSITION(seed_position) (((seed_position) + 3) / 4)
 
 /**
  * @brief A snapshot of the MRAM.
@@ -101,14 +110,19 @@ typedef uint32_t nb_request_t;
  *
  * Such a request basically contains all the information for one read.
  *
- * @var offset  The 1st neighbour address.
- * @var count   The number of neighbours.
- * @var num     A reference number to the original request.
- * @var nbr     The input neighbour to compare with the reference
+ * @var offset         The 1st neighbour address.
+ * @var count          The number of neighbours.
+ * @var seed_position  Position in the read of the seed shared with the neighbours. The input neighbour follows the seed,
+ *                     so the comparison is DELTA_SEED_POSITION(seed_position) bytes shorter, and the coordinates of the
+ *                     results are moved back by seed_position to be the ones of the beginning of the read. The scores
+ *                     do not cover the nucleotides before the seed.
+ * @var num            A reference number to the original request.
+ * @var nbr            The input neighbour to compare with the reference
  */
 typedef struct {
     uint32_t offset;
-    uint32_t count;
+    uint16_t count;
+    uint16_t seed_position;
     uint32_t num;
     uint8_t nbr[SIZE_NEIGHBOUR_IN_BYTES];
 } dpu_request_t;
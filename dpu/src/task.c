@@ -111,11 +111,18 @@ static void compare_neighbours(sysname_t tasklet_id, uint32_t *mini, coords_and_
 {
     uint32_t score, score_nodp, score_odpd = UINT_MAX;
     uint8_t *ref_nbr = &cached_coords_and_nbr->nbr[0];
+    unsigned int seed_position = request->seed_position;
+    unsigned int delta = DPU_MRAM_INFO_VAR + DELTA_SEED_POSITION(seed_position);
     STATS_TIME_VAR(start, end, acc);
 
+    /* The read would begin before the reference sequence */
+    if (cached_coords_and_nbr->coord.seed_nr < seed_position) {
+        return;
+    }
+
     STATS_GET_START_TIME(start, acc, end);
 
-    score = score_nodp = nodp(current_read_nbr, ref_nbr, *mini, SIZE_NEIGHBOUR_IN_BYTES - DPU_MRAM_INFO_VAR);
+    score = score_nodp = nodp(current_read_nbr, ref_nbr, *mini, SIZE_NEIGHBOUR_IN_BYTES - delta);
 
     STATS_GET_END_TIME(end, acc);
     STATS_STORE_NODP_TIME(tasklet_stats, (end + acc - start));
@@ -124,7 +131,7 @@ static void compare_neighbours(sysname_t tasklet_id, uint32_t *mini, coords_and_
     if (score_nodp == UINT_MAX) {
         STATS_GET_START_TIME(start, acc, end);
 
-        score_odpd = score = odpd(current_read_nbr, ref_nbr, *mini, NB_BYTES_TO_SYMS(SIZE_NEIGHBOUR_IN_BYTES, DPU_MRAM_INFO_VAR));
+        score_odpd = score = odpd(current_read_nbr, ref_nbr, *mini, NB_BYTES_TO_SYMS(SIZE_NEIGHBOUR_IN_BYTES, delta));
 
         STATS_GET_END_TIME(end, acc);
         STATS_STORE_ODPD_TIME(tasklet_stats, (end + acc - start));
@@ -147,8 +154,8 @@ static void compare_neighbours(sysname_t tasklet_id, uint32_t *mini, coords_and_
         halt();
     }
 
-    dout_add(dout, request->num, (unsigned int)score, cached_coords_and_nbr->coord.seed_nr, cached_coords_and_nbr->coord.seq_nr,
-        tasklet_stats);
+    dout_add(dout, request->num, (unsigned int)score, cached_coords_and_nbr->coord.seed_nr - seed_position,
+        cached_coords_and_nbr->coord.seq_nr, tasklet_stats);
 }
 
 static void compute_request(sysname_t tasklet_id, coords_and_nbr_t *cached_coords_and_nbr, uint8_t *current_read_nbr,
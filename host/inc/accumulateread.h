@@ -17,6 +17,11 @@ acc_results_t accumulate_get_result(unsigned int pass_id);
 
 void accumulate_read(unsigned int pass_id, unsigned int dpu_offset);
 
+/**
+ * @brief Initialize the accumulation of the results.
+ *
+ * @param max_nb_pass  Expected number of passes (0 if unknown), more passes are handled if needed.
+ */
 void accumulate_init(unsigned int max_nb_pass);
 void accumulate_free();
 
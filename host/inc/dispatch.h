@@ -10,11 +10,13 @@
 /**
  * @brief List of reads dispatched to a DPU.
  *
- * @var nb_reads  The number of requests.
- * @var reads     A table of nb_reads requests. Since the read size is not fixed, the table is a raw byte stream.
+ * @var nb_reads        The number of requests.
+ * @var nb_comparisons  The number of neighbours to compare for all the requests.
+ * @var reads           A table of nb_reads requests. Since the read size is not fixed, the table is a raw byte stream.
  */
 typedef struct {
     nb_request_t nb_reads;
+    uint32_t nb_comparisons;
     dpu_request_t *dpu_requests;
 } dispatch_request_t;
 
@@ -0,0 +1,53 @@
+/**
+ * Copyright 2016-2019 - Dominique Lavenier & UPMEM
+ */
+
+#ifndef __DISTRIBUTE_H__
+#define __DISTRIBUTE_H__
+
+#include <stdint.h>
+
+/**
+ * @brief Neighbours given to a DPU while distributing the index.
+ *
+ * @var workload  Sum of the workloads of the chunks given to the DPU (their number of neighbours times the number of
+ *                occurrences of their seed when indexing, times the number of requests they got when rebalancing).
+ * @var size      Number of neighbours given to the DPU.
+ * @var dpu_id    Number of the DPU.
+ * @var order     When a chunk was last given to the DPU, to break the ties between DPUs with the same workload.
+ */
+typedef struct distribute_index {
+    uint64_t workload;
+    uint32_t size;
+    uint32_t dpu_id;
+    uint64_t order;
+} distribute_index_t;
+
+/**
+ * @brief Start distributing chunks between the "nb_dpu" DPUs of "table" (which must be zeroed).
+ */
+void distribute_init(distribute_index_t *table, unsigned int nb_dpu);
+
+/**
+ * @brief Give a chunk of "nb_nbr" neighbours and of "workload" to the DPU with the lowest workload (the one which got a
+ * chunk the longest time ago on a tie). The DPUs are kept in a binary min-heap: it is O(log(nb_dpu)) per chunk.
+ *
+ * @param offset  Output the position of the first neighbour of the chunk in the DPU.
+ *
+ * @return The DPU the chunk has been given to.
+ */
+distribute_index_t *distribute_chunk(uint32_t nb_nbr, uint64_t workload, uint32_t *offset);
+
+/**
+ * @brief Give a copy of a chunk of "nb_nbr" neighbours to each of the "nb_copies" DPUs with the lowest workload, adding
+ * "workload" to each of them.
+ *
+ * @param dpus     Output the "nb_copies" DPUs the copies have been given to.
+ * @param offsets  Output the position of the first neighbour of each copy in its DPU.
+ */
+void distribute_chunk_copies(
+    uint32_t nb_nbr, uint64_t workload, unsigned int nb_copies, distribute_index_t **dpus, uint32_t *offsets);
+
+void distribute_free();
+
+#endif /* __DISTRIBUTE_H__ */
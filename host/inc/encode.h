@@ -0,0 +1,39 @@
+/**
+ * Copyright 2016-2019 - Dominique Lavenier & UPMEM
+ */
+
+#ifndef __ENCODE_H__
+#define __ENCODE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Encode a sequence of the reference genome on one byte per nucleotide (A -> 0, C -> 1, T -> 2, G -> 3, N -> 4).
+ */
+void encode_genome_sequence(const char *sequence, size_t size, int8_t *data);
+
+/**
+ * @brief Encode a read in the layout of the reads buffers (see getread.h) and its reverse complement in "read_rc".
+ * Only the first "size" nucleotides are encoded, the remaining ones are set to zero in both reads.
+ */
+void encode_read(const char *sequence, unsigned int size, uint8_t *read, uint8_t *read_rc);
+
+/**
+ * @brief Code the seeds starting at the "nb_seeds" first positions of "data", a sequence encoded by encode_genome_sequence,
+ * in "seed_codes" (-1 for the seeds with an N). The code is updated from one position to the next.
+ */
+void encode_seeds(const int8_t *data, size_t nb_seeds, int32_t *seed_codes);
+
+/**
+ * @brief Pack the neighbour starting at "data", a sequence encoded by encode_genome_sequence, 4 nucleotides per byte
+ * (SIZE_NEIGHBOUR_IN_BYTES bytes, the N being packed as A).
+ */
+void encode_neighbour(const int8_t *data, uint8_t *neighbour);
+
+/**
+ * @brief Count the '\n' in "size" bytes of text.
+ */
+size_t count_lines(const char *text, size_t size);
+
+#endif /* __ENCODE_H__ */
@@ -5,15 +5,65 @@
 #ifndef __GETREAD_H__
 #define __GETREAD_H__
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 
+#include "common.h"
+
+/**
+ * @brief Layout of a read in the reads buffers.
+ * The nucleotides are packed on 2 bits (nucleotide i in bits 2*(i%4) of byte i/4, as the neighbours in the index),
+ * they are followed by a mask of the N of the read (nucleotide i in bit i%8 of byte i/8) which are packed as G.
+ * Both parts are padded to 8 bytes.
+ */
+#define SIZE_READ_PACKED ALIGN_DPU((SIZE_READ + 3) / 4)
+#define SIZE_READ_N_MASK ALIGN_DPU((SIZE_READ + 7) / 8)
+#define SIZE_READ_IN_BYTES (SIZE_READ_PACKED + SIZE_READ_N_MASK)
+
+static inline int read_get_nucleotide(const uint8_t *read, unsigned int i) { return (read[i / 4] >> (2 * (i % 4))) & 3; }
+
+static inline bool read_is_n(const uint8_t *read, unsigned int i) { return (read[SIZE_READ_PACKED + i / 8] >> (i % 8)) & 1; }
+
 int get_reads_in_buffer(unsigned int pass_id);
 
-int8_t *get_reads_buffer(unsigned int pass_id);
+uint8_t *get_reads_buffer(unsigned int pass_id);
+
+/**
+ * @brief Fill the reads buffer of the pass with the next reads of the input files, without the pairs dropped by the
+ * pre-filter (see prefilter.h). The passes entirely dropped are skipped: a pass without any read is the end of the inputs.
+ */
+void get_reads(unsigned int pass_id);
+
+/**
+ * @brief Set the input files to read from.
+ * Regular files are memory-mapped and parsed in place, others are parsed with stdio.
+ * The lines of uncompressed regular files are counted to know where each pass begins.
+ * If both files are the same, it is parsed with stdio as interleaved pairs, once (the reads must then be cached to be
+ * read again).
+ *
+ * @param cache_reads  Whether the reads will be read again, in which case they are encoded once and cached.
+ */
+void get_reads_init(FILE *fpe1, FILE *fpe2, bool cache_reads);
+
+/**
+ * @brief Restart reading from the beginning of the input files (and print the parsing throughput and the pre-filter
+ * statistics).
+ * Once the inputs have been read entirely, the next reads come from the cache if it is used.
+ */
+void get_reads_rewind();
 
-void get_reads(FILE *fpe1, FILE *fpe2, unsigned int pass_id);
+void get_reads_free();
 
-int get_input_info(FILE *f, size_t *read_size, size_t *nb_read);
+/**
+ * @brief Get the size of the reads of the input file.
+ */
+int get_input_info(FILE *f, size_t *read_size);
+
+/**
+ * @brief Get the exact number of passes needed to read the inputs given to get_reads_init (0 if it is not known, which
+ * is the case for compressed inputs and inputs that are not regular files).
+ */
+unsigned int get_reads_nb_pass();
 
 #endif /* __GETREAD_H__ */
@@ -8,33 +8,33 @@
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
-#include <sys/queue.h>
 
 /**
- * @brief Structure of a list of index of neighbour that shared the same seed.
+ * @brief Chunk of the neighbours that share the same seed, dispatched to a DPU.
+ * The chunks of a seed are contiguous in the index, each one followed by its copies on other DPUs if it has some.
  *
- * @var nb_nbr   Number of neighbour.
- * @var offset   Address in the DPU memory of the first neighbour to compute.
- * @var num_dpu  DPU number where the reference seed that match has been dispatch.
- * @var next     Needed to have a linked-list of index.
+ * @var offset       Address in the DPU memory of the first neighbour to compute.
+ * @var num_dpu      DPU number where the chunk has been dispatch.
+ * @var nb_nbr       Number of neighbour.
+ * @var nb_replicas  Number of copies of the chunk following it in the index (0 for the copies themselves).
  */
 typedef struct index_seed {
-    uint32_t nb_nbr;
     uint32_t offset;
-    uint32_t num_dpu;
-    struct index_seed *next;
+    uint16_t num_dpu;
+    uint16_t nb_nbr : 12;
+    uint16_t nb_replicas : 4;
 } index_seed_t;
 
-TAILQ_HEAD(distribute_index_list, distribute_index);
-typedef struct distribute_index {
-    uint64_t workload;
-    uint32_t size;
-    uint32_t dpu_id;
-    TAILQ_ENTRY(distribute_index) entries;
-} distribute_index_t;
+/**
+ * @brief Maximum number of DPUs holding the same chunk (the chunk and its copies).
+ */
+#define MAX_CHUNK_COPIES (16)
 
 char *get_index_folder();
 
+/**
+ * @brief Map index.bin read-only in memory, it is used in place (and shared with the other processes using it).
+ */
 void index_load();
 
 void index_create();
@@ -43,11 +43,45 @@ void index_create_folder();
 
 void index_free();
 
-index_seed_t *index_get(int8_t *read);
+/**
+ * @brief Get the chunks of the rarest seed of "read" in the reference genome, among the seeds at several positions at the
+ * beginning of the read (the first one on a tie, to keep the longest neighbour to compare).
+ *
+ * @param seed_position  Output the position of the seed in the read.
+ * @param nb_chunks      Output the number of chunks, copies included (0 if none of the seeds is in the index, being absent
+ *                       from the reference genome or too frequent).
+ */
+index_seed_t *index_get(uint8_t *read, unsigned int *seed_position, unsigned int *nb_chunks);
 
 unsigned int index_get_nb_dpu();
 
-void index_copy_neighbour(int8_t *dst, int8_t *src);
+/**
+ * @brief Get the number of chunks of the loaded index.
+ */
+uint64_t index_get_nb_chunks();
+
+/**
+ * @brief Count in "chunk_hits" (one counter per chunk of the index) the requests the "nb_reads" reads of "reads" are
+ * dispatched as (see index_get). The requests on the copies of a chunk are counted on the chunk.
+ */
+void index_count_hits(uint8_t *reads, unsigned int nb_reads, uint32_t *chunk_hits);
+
+/**
+ * @brief Distribute again the chunks of the loaded index between "nb_dpu" DPUs, from the most to the least costly: a chunk
+ * costs its number of neighbours times the number of requests it got in "chunk_hits" (see index_count_hits), shared
+ * between its copies. The neighbours are moved between the MRAM files accordingly, and index.bin is rewritten.
+ */
+void index_rebalance(const uint32_t *chunk_hits, unsigned int nb_dpu);
+
+/**
+ * @brief Get the size of the reads the existing index has been built for (0 if there is no index).
+ */
+unsigned int index_get_size_read();
+
+/**
+ * @brief Copy the neighbour of "read" following its seed at "seed_position".
+ */
+void index_copy_neighbour(int8_t *dst, uint8_t *read, unsigned int seed_position);
 
 enum xfer_direction {
     xfer_read,
@@ -0,0 +1,29 @@
+/**
+ * Copyright 2016-2019 - Dominique Lavenier & UPMEM
+ */
+
+#ifndef __MRAM_COMPRESS_H__
+#define __MRAM_COMPRESS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Maximum size of the compressed MRAM image of "size" bytes.
+ */
+size_t mram_compress_bound(size_t size);
+
+/**
+ * @brief Compress the MRAM image "mram" of "size" bytes (a whole number of coords_and_nbr_t) into "out", of at least
+ * mram_compress_bound(size) bytes.
+ *
+ * @return The size of the compressed image.
+ */
+size_t mram_compress(const uint8_t *mram, size_t size, uint8_t *out);
+
+/**
+ * @brief Decompress the MRAM image of "size" bytes compressed in "in", of "compressed_size" bytes, into "mram".
+ */
+void mram_decompress(const uint8_t *in, size_t compressed_size, uint8_t *mram, size_t size);
+
+#endif /* __MRAM_COMPRESS_H__ */
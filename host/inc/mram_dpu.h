@@ -14,12 +14,51 @@
 #include <stdint.h>
 
 #include "common.h"
+#include "distribute.h"
 #include "index.h"
 
+/**
+ * @brief Read the MRAM image of the DPU "dpu_id" from the pack of the index folder into "*mram" (allocated for the whole
+ * MRAM available to the index), or point "*mram" to the image in shared memory when it was preloaded. "*mram" is released
+ * with "mram_free".
+ *
+ * @return The size of the image.
+ */
 size_t mram_load(uint8_t **mram, unsigned int dpu_id);
 
+/**
+ * @brief Release an MRAM image given by "mram_load".
+ */
+void mram_free(uint8_t *mram);
+
+/**
+ * @brief Read the MRAM images of the "nb_mram" DPUs "dpu_ids" as "mram_load" does, into "mrams" and "sizes", on several
+ * threads reading and decompressing an image each. The DPUs not in the pack of the index folder are skipped.
+ */
+void mram_load_all(unsigned int nb_mram, const unsigned int *dpu_ids, uint8_t **mrams, size_t *sizes);
+
+/**
+ * @brief Decompress the MRAM images of the pack of the index folder into a shared memory object, where the next runs on
+ * the index take them from.
+ */
+void mram_preload();
+
 void init_vmis(unsigned int nb_dpu, distribute_index_t *table);
 void free_vmis(unsigned int nb_dpu);
 void write_vmi(unsigned int num_dpu, unsigned int num_ref, coords_and_nbr_t *coords_and_nbr);
 
+/**
+ * @brief Write the neighbours staged for the DPUs helping indexing to their MRAMs once they take all the memory given to
+ * them. To be called when no thread is calling "write_vmi".
+ */
+void flush_vmis();
+
+/**
+ * @brief Move the neighbours of the "nb_chunks" chunks of the index from the MRAM images of "nb_dpu_src" DPUs, where
+ * "src_chunks" places them, to the MRAM images of the "nb_dpu_dst" DPUs of "table", where "dst_chunks" places them. The
+ * pack of the MRAM images is rewritten.
+ */
+void mram_move_chunks(unsigned int nb_dpu_src, unsigned int nb_dpu_dst, distribute_index_t *table,
+    const index_seed_t *src_chunks, const index_seed_t *dst_chunks, uint64_t nb_chunks);
+
 #endif /* __INTEGRATION_MDPU_H__ */
@@ -7,7 +7,7 @@
 
 #include <stdbool.h>
 
-typedef enum { goal_unknown, goal_index, goal_map } goal_t;
+typedef enum { goal_unknown, goal_index, goal_map, goal_rebalance, goal_preload } goal_t;
 
 /**
  * @brief Get the path where to store temporary and final file
@@ -15,6 +15,11 @@ typedef enum { goal_unknown, goal_index, goal_map } goal_t;
  */
 char *get_input_path();
 
+/**
+ * @brief Get the path of the interleaved FASTQ input ("-" for the standard input), NULL if the reads are in separate files.
+ */
+char *get_interleaved_input();
+
 /**
  * @brief Get the goal of the run of the application.
  */
@@ -36,6 +41,36 @@ unsigned int get_nb_thread_for_simu();
 
 bool get_index_with_dpus();
 
+/**
+ * @brief Whether the MRAM images are compressed when indexing.
+ */
+bool get_index_compressed();
+
+/**
+ * @brief Get the maximum number of N in a read for its pair to be mapped.
+ */
+unsigned int get_prefilter_max_n();
+
+/**
+ * @brief Get the minimum number of distinct trinucleotides in a read for its pair to be mapped.
+ */
+unsigned int get_prefilter_min_complexity();
+
+/**
+ * @brief Get the maximum number of occurrences in the reference genome of a seed to be indexed (0 for no maximum).
+ */
+unsigned int get_max_seed_occurrences();
+
+/**
+ * @brief Get the maximum number of DPUs a chunk of the index is copied on when it is compared to many reads.
+ */
+unsigned int get_max_chunk_copies();
+
+/**
+ * @brief Get the maximum number of MB the MRAM images built when indexing are kept in memory with (0 for no maximum).
+ */
+unsigned int get_index_max_memory();
+
 /**
  * @brief Parse and validate the argument of the application.
  */
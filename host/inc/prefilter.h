@@ -0,0 +1,51 @@
+/**
+ * Copyright 2016-2019 - Dominique Lavenier & UPMEM
+ */
+
+#ifndef __PREFILTER_H__
+#define __PREFILTER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Statistics of the pre-filter.
+ *
+ * @var nb_pairs                 Number of pairs checked.
+ * @var nb_n_rich_pairs          Number of pairs dropped because a read has too many N.
+ * @var nb_low_complexity_pairs  Number of pairs dropped because a read is made of too few distinct trinucleotides.
+ * @var nb_requests              Number of DPU requests the dropped pairs would have been dispatched as.
+ * @var nb_comparisons           Number of neighbours the DPUs would have compared the dropped pairs to.
+ */
+typedef struct {
+    uint64_t nb_pairs;
+    uint64_t nb_n_rich_pairs;
+    uint64_t nb_low_complexity_pairs;
+    uint64_t nb_requests;
+    uint64_t nb_comparisons;
+} prefilter_stats_t;
+
+/**
+ * @brief Whether the pre-filter can drop any pair with the thresholds given on the command line.
+ */
+bool prefilter_enabled();
+
+/**
+ * @brief Drop the pairs of "reads" (4 reads per pair, see getread.h) in which a read has more N than allowed or is of
+ * too low complexity (homopolymer, short tandem repeat). The pairs kept are moved to the beginning of "reads", in order.
+ *
+ * @return The number of pairs kept.
+ */
+unsigned int prefilter_pairs(uint8_t *reads, unsigned int nb_pairs, prefilter_stats_t *stats);
+
+/**
+ * @brief Add the statistics of a call to "prefilter_pairs" to the statistics of the run.
+ */
+void prefilter_add_stats(const prefilter_stats_t *stats);
+
+/**
+ * @brief Print and reset the statistics of the run.
+ */
+void prefilter_print_stats();
+
+#endif /* __PREFILTER_H__ */
@@ -7,7 +7,7 @@
 
 #define VERSION "VERSION 1.8"
 #define MAX_READS_BUFFER (512 * 1024) /* Maximum number of read by round        */
-#define NB_READS_BUFFER (16) /* To be increase if enough legacy memory available */
+#define NB_READS_BUFFER (32) /* To be increase if enough legacy memory available */
 #define NB_DISPATCH_AND_ACC_BUFFER (4) /* To be increase if enough legacy memory available */
 #define NB_ROUND (1)
 
@@ -20,6 +20,7 @@
 #include <errno.h>
 #include <pthread.h>
 #include <stdarg.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -48,6 +49,11 @@ enum error_code {
     ERR_NO_GOAL_DEFINED = -8,
     ERR_CURRENT_FOLDER_PERMISSIONS = -8,
     ERR_FOPEN_FAILED = -9,
+    ERR_GETREAD_DECOMPRESSION_FAILED = -10,
+    ERR_READ_SIZE_NOT_SUPPORTED = -11,
+    ERR_INDEX_MAX_MEMORY_TOO_LOW = -12,
+    ERR_MRAM_CACHE_FAILED = -13,
+    ERR_GETREAD_UNPAIRED_READS = -14,
 };
 
 #define WARNING(fmt, ...)                                                                                                        \
@@ -70,7 +76,12 @@ enum error_code {
             ERROR_EXIT(ERR_FOPEN_FAILED, "Could not open file '%s' (%s)", name, strerror(errno));                                \
     } while (0)
 
-static inline void check_ulimit_n(unsigned int expected_limit)
+/**
+ * @brief Warn when the process cannot open "expected_limit" files.
+ *
+ * @return Whether it was warned.
+ */
+static inline bool warn_ulimit_n(unsigned int expected_limit)
 {
     struct rlimit nofile_limit;
     assert(getrlimit(RLIMIT_NOFILE, &nofile_limit) == 0);
@@ -78,6 +89,17 @@ static inline void check_ulimit_n(unsigned int expected_limit)
         WARNING("Number of file descriptor that can be opened by this process looks too small (current: %u - expected: %u), use "
                 "'ulimit -n' to set to appropriate value",
             (unsigned int)nofile_limit.rlim_cur, expected_limit);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Warn when the process cannot open "expected_limit" files, and wait for the user to continue.
+ */
+static inline void check_ulimit_n(unsigned int expected_limit)
+{
+    if (warn_ulimit_n(expected_limit)) {
         printf("Press any key to continue\n");
         getchar();
     }
@@ -5,6 +5,7 @@
 #include "accumulateread.h"
 #include "common.h"
 #include "index.h"
+#include "parse_args.h"
 #include "upvc.h"
 
 #include <assert.h>
@@ -12,12 +13,14 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/queue.h>
 #include <unistd.h>
 
 #define MIN(a, b) ((a) > (b) ? (b) : (a))
 
 static FILE **result_file;
+static pthread_mutex_t result_file_mutex = PTHREAD_MUTEX_INITIALIZER;
 static acc_results_t *results_buffers[NB_DISPATCH_AND_ACC_BUFFER];
 #define RESULTS_BUFFERS(pass_id) results_buffers[(pass_id) % NB_DISPATCH_AND_ACC_BUFFER]
 
@@ -158,26 +161,49 @@ static void merge_bucket_and_acc_list(
     }
 }
 
-acc_results_t accumulate_get_result(unsigned int pass_id)
+/**
+ * @brief Get the file storing the results of the pass.
+ * The table of files grows when the number of passes was unknown or under-estimated (compressed inputs or stream), with
+ * a warning if the file descriptors may run out, as each pass keeps its file open. The mapping is running, and its reads
+ * may come from stdin: there is no waiting for the user here, a file failing to open stopping the mapping.
+ */
+static FILE *get_result_file(unsigned int pass_id)
 {
+    pthread_mutex_lock(&result_file_mutex);
+    if (pass_id >= nb_pass) {
+        unsigned int new_nb_pass = (pass_id + 1 > nb_pass * 2) ? pass_id + 1 : nb_pass * 2;
+        warn_ulimit_n(new_nb_pass + 16);
+        result_file = (FILE **)realloc(result_file, new_nb_pass * sizeof(FILE *));
+        assert(result_file != NULL);
+        memset(&result_file[nb_pass], 0, (new_nb_pass - nb_pass) * sizeof(FILE *));
+        nb_pass = new_nb_pass;
+    }
     if (result_file[pass_id] == NULL) {
         static const dpu_result_out_t dummy_res = { .num = -1 };
         char result_filename[512];
         sprintf(result_filename, "result_%u.bin", pass_id);
 
         result_file[pass_id] = fopen(result_filename, "w+");
-        assert(result_file[pass_id] != NULL);
+        CHECK_FILE(result_file[pass_id], result_filename);
         assert(unlink(result_filename) == 0);
         fwrite(&dummy_res, sizeof(dummy_res), 1, result_file[pass_id]);
     }
+    FILE *f = result_file[pass_id];
+    pthread_mutex_unlock(&result_file_mutex);
+    return f;
+}
 
-    fseek(result_file[pass_id], 0, SEEK_END);
-    size_t size = ftell(result_file[pass_id]);
-    rewind(result_file[pass_id]);
+acc_results_t accumulate_get_result(unsigned int pass_id)
+{
+    FILE *f = get_result_file(pass_id);
+
+    fseek(f, 0, SEEK_END);
+    size_t size = ftell(f);
+    rewind(f);
 
     dpu_result_out_t *results = (dpu_result_out_t *)malloc(size);
     assert(results != NULL);
-    size_t size_read = fread(results, size, 1, result_file[pass_id]);
+    size_t size_read = fread(results, size, 1, f);
     assert(size_read == 1);
 
     return (acc_results_t) { .nb_res = (size / sizeof(dpu_result_out_t)) - 1, .results = results };
@@ -246,8 +272,9 @@ void accumulate_read(unsigned int pass_id, unsigned int dpu_offset)
     // update FILE *
     free(acc_res_from_file.results);
     merged_result_tab[nb_read].num = -1;
-    rewind(result_file[pass_id]);
-    size_t written_size = fwrite(merged_result_tab, size, 1, result_file[pass_id]);
+    FILE *f = get_result_file(pass_id);
+    rewind(f);
+    size_t written_size = fwrite(merged_result_tab, size, 1, f);
     assert(written_size == 1);
     free(merged_result_tab);
     free(bucket_elems);
@@ -284,8 +311,14 @@ void accumulate_free()
 
 void accumulate_init(unsigned int max_nb_pass)
 {
-    nb_pass = max_nb_pass;
-    check_ulimit_n(nb_pass + 16);
+    nb_pass = (max_nb_pass != 0) ? max_nb_pass : 1;
+    /* The standard input can be the reads (-p -), not an answer of the user */
+    char *interleaved_input = get_interleaved_input();
+    if (interleaved_input != NULL && strcmp(interleaved_input, "-") == 0) {
+        warn_ulimit_n(nb_pass + 16);
+    } else {
+        check_ulimit_n(nb_pass + 16);
+    }
 
     result_file = (FILE **)calloc(nb_pass, sizeof(FILE *));
     assert(result_file != NULL);
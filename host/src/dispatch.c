@@ -20,38 +20,55 @@ static dispatch_request_t *requests_buffers[NB_DISPATCH_AND_ACC_BUFFER];
 #define REQUESTS_BUFFERS(pass_id) requests_buffers[(pass_id) % NB_DISPATCH_AND_ACC_BUFFER]
 
 static unsigned int dispatch_pass_id;
-static int8_t *read_buffer;
+static uint8_t *read_buffer;
 static int nb_read;
 static dispatch_request_t *requests;
 static pthread_barrier_t barrier;
 static pthread_t thread_id[DISPATCHING_THREAD_SLAVE];
 static bool stop_threads = false;
 
-static void write_mem_DPU(index_seed_t *seed, int8_t *read, int num_read)
+/**
+ * @brief Get the copy of the chunk "seed" (the chunk itself included) on the DPU with the least neighbours to compare in
+ * this pass so far.
+ */
+static index_seed_t *least_loaded_copy(index_seed_t *seed)
+{
+    index_seed_t *best_copy = seed;
+    for (index_seed_t *copy = &seed[1]; copy <= &seed[seed->nb_replicas]; copy++) {
+        if (requests[copy->num_dpu].nb_comparisons < requests[best_copy->num_dpu].nb_comparisons) {
+            best_copy = copy;
+        }
+    }
+    return best_copy;
+}
+
+static void write_mem_DPU(index_seed_t *seed, unsigned int nb_chunks, unsigned int seed_position, uint8_t *read, int num_read)
 {
-    while (seed != NULL) {
-        unsigned int num_dpu = seed->num_dpu;
+    for (index_seed_t *last_seed = &seed[nb_chunks]; seed != last_seed; seed += 1 + seed->nb_replicas) {
+        index_seed_t *copy = (seed->nb_replicas == 0) ? seed : least_loaded_copy(seed);
+        unsigned int num_dpu = copy->num_dpu;
         unsigned int nb_reads = __sync_fetch_and_add(&requests[num_dpu].nb_reads, 1);
+        __sync_fetch_and_add(&requests[num_dpu].nb_comparisons, copy->nb_nbr);
         dpu_request_t *new_read = &requests[num_dpu].dpu_requests[nb_reads];
-        new_read->offset = seed->offset;
-        new_read->count = seed->nb_nbr;
+        new_read->offset = copy->offset;
+        new_read->count = copy->nb_nbr;
+        new_read->seed_position = seed_position;
         new_read->num = num_read;
 
-        index_copy_neighbour((int8_t *)new_read->nbr, read);
+        index_copy_neighbour((int8_t *)new_read->nbr, read, seed_position);
         if (nb_reads > MAX_DPU_REQUEST) {
             ERROR_EXIT(ERR_DISPATCH_BUFFER_FULL, "%s:[P%u]: Buffer full (DPU#%u)", __func__, dispatch_pass_id, num_dpu);
         }
-
-        seed = seed->next;
     }
 }
 
 static void do_dispatch_read(int thread_id)
 {
     for (int num_read = thread_id; num_read < nb_read; num_read += DISPATCHING_THREAD) {
-        int8_t *read = &read_buffer[num_read * SIZE_READ];
-        index_seed_t *seed = index_get(read);
-        write_mem_DPU(seed, read, num_read);
+        uint8_t *read = &read_buffer[num_read * SIZE_READ_IN_BYTES];
+        unsigned int seed_position, nb_chunks;
+        index_seed_t *seed = index_get(read, &seed_position, &nb_chunks);
+        write_mem_DPU(seed, nb_chunks, seed_position, read, num_read);
     }
 }
 
@@ -77,6 +94,7 @@ void dispatch_read(unsigned int pass_id)
 
     for (int numdpu = 0; numdpu < nb_dpu; numdpu++) {
         requests[numdpu].nb_reads = 0;
+        requests[numdpu].nb_comparisons = 0;
     }
 
     pthread_barrier_wait(&barrier);
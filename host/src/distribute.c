@@ -0,0 +1,127 @@
+/**
+ * Copyright 2016-2019 - Dominique Lavenier & UPMEM
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "distribute.h"
+
+/**
+ * @brief Entry of the heap of the DPUs, the key is copied in the entry to compare the DPUs without dereferencing them.
+ */
+typedef struct {
+    uint64_t workload;
+    uint64_t order;
+    distribute_index_t *dpu;
+} heap_entry_t;
+
+static const heap_entry_t sentinel = { .workload = UINT64_MAX, .order = UINT64_MAX, .dpu = NULL };
+static heap_entry_t *heap;
+static unsigned int heap_size;
+static uint64_t nb_chunks_distributed;
+
+static bool less_loaded(const heap_entry_t *a, const heap_entry_t *b)
+{
+    return (a->workload < b->workload) | ((a->workload == b->workload) & (a->order < b->order));
+}
+
+/**
+ * @brief Put "entry" in the hole at "position" of the heap, or above it.
+ */
+static void sift_up(unsigned int position, heap_entry_t entry)
+{
+    while (position != 0) {
+        unsigned int parent = (position - 1) / 2;
+        if (!less_loaded(&entry, &heap[parent])) {
+            break;
+        }
+        heap[position] = heap[parent];
+        position = parent;
+    }
+    heap[position] = entry;
+}
+
+/**
+ * @brief Move the root of the heap to its place. The DPU at the root just got a chunk, it usually goes down to the
+ * bottom: the hole is moved down to a leaf by following the least loaded children, then the entry goes back up.
+ */
+static void sift_down_root()
+{
+    heap_entry_t entry = heap[0];
+    unsigned int position = 0;
+    unsigned int child;
+    while ((child = 2 * position + 1) < heap_size) {
+        /* Without branch, which would be mispredicted half of the time (the sentinel stands for a missing right child) */
+        child += less_loaded(&heap[child + 1], &heap[child]);
+        heap[position] = heap[child];
+        position = child;
+    }
+    sift_up(position, entry);
+}
+
+void distribute_init(distribute_index_t *table, unsigned int nb_dpu)
+{
+    assert(nb_dpu != 0);
+    heap = (heap_entry_t *)malloc((nb_dpu + 1) * sizeof(heap_entry_t));
+    assert(heap != NULL);
+    heap_size = nb_dpu;
+    heap[nb_dpu] = sentinel;
+
+    /* The first chunks go to the last DPUs first. With the orders increasing along the array, it is already a heap */
+    for (unsigned int each_dpu = 0; each_dpu < nb_dpu; each_dpu++) {
+        distribute_index_t *dpu = &table[nb_dpu - 1 - each_dpu];
+        dpu->dpu_id = nb_dpu - 1 - each_dpu;
+        dpu->order = each_dpu;
+        heap[each_dpu] = (heap_entry_t) { .workload = dpu->workload, .order = dpu->order, .dpu = dpu };
+    }
+    nb_chunks_distributed = nb_dpu;
+}
+
+distribute_index_t *distribute_chunk(uint32_t nb_nbr, uint64_t workload, uint32_t *offset)
+{
+    distribute_index_t *dpu = heap[0].dpu;
+    *offset = dpu->size;
+    dpu->size += nb_nbr;
+    dpu->workload += workload;
+    dpu->order = nb_chunks_distributed++;
+    heap[0].workload = dpu->workload;
+    heap[0].order = dpu->order;
+    sift_down_root();
+    return dpu;
+}
+
+void distribute_chunk_copies(
+    uint32_t nb_nbr, uint64_t workload, unsigned int nb_copies, distribute_index_t **dpus, uint32_t *offsets)
+{
+    assert(nb_copies != 0 && nb_copies <= heap_size);
+
+    /* The DPUs are taken out of the heap as they get a copy, so that no other copy goes to them */
+    for (unsigned int each_copy = 0; each_copy < nb_copies; each_copy++) {
+        distribute_index_t *dpu = heap[0].dpu;
+        offsets[each_copy] = dpu->size;
+        dpu->size += nb_nbr;
+        dpu->workload += workload;
+        dpu->order = nb_chunks_distributed++;
+        dpus[each_copy] = dpu;
+
+        heap_size--;
+        heap[0] = heap[heap_size];
+        heap[heap_size] = sentinel;
+        sift_down_root();
+    }
+    for (unsigned int each_copy = 0; each_copy < nb_copies; each_copy++) {
+        distribute_index_t *dpu = dpus[each_copy];
+        sift_up(heap_size, (heap_entry_t) { .workload = dpu->workload, .order = dpu->order, .dpu = dpu });
+        heap_size++;
+        heap[heap_size] = sentinel;
+    }
+}
+
+void distribute_free()
+{
+    free(heap);
+    heap = NULL;
+    heap_size = 0;
+}
@@ -326,7 +326,6 @@ static dpu_error_t load_mram_rank(struct dpu_set_t rank, uint32_t rank_id, void
     load_info_t info = (load_info_t)(uintptr_t)args;
     unsigned int dpu_offset = info.dpu_offset;
     unsigned int delta_neighbour = info.delta_neighbour;
-    unsigned int nb_dpu = index_get_nb_dpu();
     unsigned int nb_dpus_per_rank = devices.nb_dpus_per_rank[rank_id];
     uint8_t *mram[nb_dpus_per_rank];
     size_t mram_size[nb_dpus_per_rank];
@@ -334,15 +333,14 @@ static dpu_error_t load_mram_rank(struct dpu_set_t rank, uint32_t rank_id, void
     memset(mram, 0, sizeof(uint8_t *) * nb_dpus_per_rank);
     memset(mram_size, 0, sizeof(size_t) * nb_dpus_per_rank);
 
+    unsigned int this_dpu[nb_dpus_per_rank];
     unsigned int each_dpu;
     struct dpu_set_t dpu;
     unsigned int mram_offset = devices.rank_mram_offset[rank_id];
     DPU_FOREACH (rank, dpu, each_dpu) {
-        unsigned int this_dpu = dpu_offset + dpu_tid[each_dpu + mram_offset];
-        if (this_dpu < nb_dpu) {
-            mram_size[each_dpu] = mram_load(&mram[each_dpu], this_dpu);
-        }
+        this_dpu[each_dpu] = dpu_offset + dpu_tid[each_dpu + mram_offset];
     }
+    mram_load_all(nb_dpus_per_rank, this_dpu, mram, mram_size);
 
     unsigned int max_mram_size = 0;
     DPU_FOREACH (rank, dpu, each_dpu) {
@@ -354,7 +352,7 @@ static dpu_error_t load_mram_rank(struct dpu_set_t rank, uint32_t rank_id, void
     DPU_ASSERT(dpu_copy_to(rank, XSTR(DPU_MRAM_INFO_VAR), 0, &delta_neighbour, sizeof(delta_neighbour)));
 
     DPU_FOREACH (rank, dpu, each_dpu) {
-        free(mram[each_dpu]);
+        mram_free(mram[each_dpu]);
     }
     return DPU_OK;
 }
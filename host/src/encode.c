@@ -0,0 +1,386 @@
+/**
+ * Copyright 2016-2019 - Dominique Lavenier & UPMEM
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define ENCODE_SIMD
+#endif
+
+#include "encode.h"
+#include "getread.h"
+
+/* A -> 0, C -> 1, T -> 2, G -> 3 */
+#define ENCODE_NUCLEOTIDE(c) ((((int)(c)) >> 1) & 3)
+#define IS_N(c) (((c) | 0x20) == 'n')
+#define NUCLEOTIDE_N (4)
+#define COMPLEMENT (2) /* A <-> T, C <-> G */
+
+/**
+ * @brief Number of nucleotides packed in a neighbour.
+ */
+#define SIZE_NEIGHBOUR (SIZE_NEIGHBOUR_IN_BYTES * 4)
+
+/**
+ * @brief Number of nucleotides encoded by the vectorized kernels, SIZE_READ rounded up to the size of the largest vectors.
+ */
+#define SIZE_READ_CODES (((SIZE_READ + 31) / 32) * 32)
+
+/**
+ * @brief Set to zero the bytes of the read after the "nb_encoded" first nucleotides written by a kernel.
+ */
+static inline void clear_padding(uint8_t *read, unsigned int nb_encoded)
+{
+    memset(&read[nb_encoded / 4], 0, SIZE_READ_PACKED - nb_encoded / 4);
+    memset(&read[SIZE_READ_PACKED + nb_encoded / 8], 0, SIZE_READ_N_MASK - nb_encoded / 8);
+}
+
+static void encode_genome_sequence_scalar(const char *sequence, size_t size, int8_t *data)
+{
+    for (size_t i = 0; i < size; i++) {
+        data[i] = IS_N(sequence[i]) ? NUCLEOTIDE_N : ENCODE_NUCLEOTIDE(sequence[i]);
+    }
+}
+
+static void encode_read_scalar(const char *sequence, unsigned int size, uint8_t *read, uint8_t *read_rc)
+{
+    memset(read, 0, SIZE_READ_IN_BYTES);
+    memset(read_rc, 0, SIZE_READ_IN_BYTES);
+    for (unsigned int i = 0; i < size; i++) {
+        int nucleotide = ENCODE_NUCLEOTIDE(sequence[i]);
+        unsigned int j = size - i - 1;
+        read[i / 4] |= nucleotide << (2 * (i % 4));
+        read_rc[j / 4] |= (nucleotide ^ COMPLEMENT) << (2 * (j % 4));
+        if (IS_N(sequence[i])) {
+            read[SIZE_READ_PACKED + i / 8] |= 1 << (i % 8);
+            read_rc[SIZE_READ_PACKED + j / 8] |= 1 << (j % 8);
+        }
+    }
+}
+
+/**
+ * @brief Pack the "size" (a multiple of 4) nucleotides of "data" 4 per byte, the N being packed as A.
+ */
+static void pack_nucleotides_scalar(const int8_t *data, unsigned int size, uint8_t *packed)
+{
+    for (unsigned int i = 0; i < size; i += 4) {
+        packed[i / 4] = (data[i] & 3) | ((data[i + 1] & 3) << 2) | ((data[i + 2] & 3) << 4) | ((data[i + 3] & 3) << 6);
+    }
+}
+
+static void encode_neighbour_scalar(const int8_t *data, uint8_t *neighbour)
+{
+    pack_nucleotides_scalar(data, SIZE_NEIGHBOUR, neighbour);
+}
+
+static size_t count_lines_scalar(const char *text, size_t size)
+{
+    size_t nb_lines = 0;
+    for (size_t i = 0; i < size; i++) {
+        nb_lines += (text[i] == '\n');
+    }
+    return nb_lines;
+}
+
+#ifdef ENCODE_SIMD
+
+/*
+ * The line counting kernels accumulate the comparisons in byte counters for at most 255 vectors before summing them
+ * with sad (sum of absolute differences with zero).
+ */
+
+__attribute__((target("sse4.2"))) static size_t count_lines_sse42(const char *text, size_t size)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    size_t nb_lines = 0;
+    size_t i = 0;
+    while (i + 16 <= size) {
+        __m128i counters = zero;
+        for (unsigned int each_vector = 0; each_vector < 255 && i + 16 <= size; each_vector++, i += 16) {
+            __m128i chars = _mm_loadu_si128((const __m128i *)&text[i]);
+            counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(chars, newline));
+        }
+        __m128i sums = _mm_sad_epu8(counters, zero);
+        nb_lines += _mm_cvtsi128_si64(sums) + _mm_extract_epi64(sums, 1);
+    }
+    return nb_lines + count_lines_scalar(&text[i], size - i);
+}
+
+__attribute__((target("avx2"))) static size_t count_lines_avx2(const char *text, size_t size)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    size_t nb_lines = 0;
+    size_t i = 0;
+    while (i + 32 <= size) {
+        __m256i counters = zero;
+        for (unsigned int each_vector = 0; each_vector < 255 && i + 32 <= size; each_vector++, i += 32) {
+            __m256i chars = _mm256_loadu_si256((const __m256i *)&text[i]);
+            counters = _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(chars, newline));
+        }
+        __m256i sums = _mm256_sad_epu8(counters, zero);
+        nb_lines += _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) + _mm256_extract_epi64(sums, 2)
+            + _mm256_extract_epi64(sums, 3);
+    }
+    return nb_lines + count_lines_scalar(&text[i], size - i);
+}
+
+/*
+ * The vectorized kernels encode the read on one byte per nucleotide (with the N flagged by bit 2) in "codes",
+ * then write its reverse complement in "codes_rc" such that codes_rc[k] is the complement of
+ * codes[SIZE_READ_CODES - 1 - k]: the reverse complement of a read of "size" nucleotides starts at
+ * codes_rc[SIZE_READ_CODES - size] and is followed by zeros.
+ * Both are finally packed 4 nucleotides per byte using multiply-add instructions, and the N flags are extracted with movemask.
+ */
+
+__attribute__((target("sse4.2"))) static void encode_genome_sequence_sse42(const char *sequence, size_t size, int8_t *data)
+{
+    const __m128i mask = _mm_set1_epi8(3);
+    const __m128i lower_case = _mm_set1_epi8(0x20);
+    const __m128i n = _mm_set1_epi8('n');
+    const __m128i nucleotide_n = _mm_set1_epi8(NUCLEOTIDE_N);
+    size_t i;
+    for (i = 0; i + 16 <= size; i += 16) {
+        __m128i chars = _mm_loadu_si128((const __m128i *)&sequence[i]);
+        __m128i code = _mm_and_si128(_mm_srli_epi16(chars, 1), mask);
+        __m128i is_n = _mm_cmpeq_epi8(_mm_or_si128(chars, lower_case), n);
+        _mm_storeu_si128((__m128i *)&data[i], _mm_blendv_epi8(code, nucleotide_n, is_n));
+    }
+    encode_genome_sequence_scalar(&sequence[i], size - i, &data[i]);
+}
+
+__attribute__((target("sse4.2"))) static void pack_read_sse42(const int8_t *codes, uint8_t *read)
+{
+    const __m128i mask = _mm_set1_epi8(3);
+    const __m128i pair_weights = _mm_set1_epi16(0x0401);
+    const __m128i quad_weights = _mm_set1_epi32(0x00100001);
+    const __m128i gather = _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    unsigned int i;
+    for (i = 0; i < SIZE_READ; i += 16) {
+        __m128i code = _mm_loadu_si128((const __m128i *)&codes[i]);
+        __m128i pairs = _mm_maddubs_epi16(_mm_and_si128(code, mask), pair_weights);
+        __m128i quads = _mm_madd_epi16(pairs, quad_weights);
+        uint32_t packed = _mm_cvtsi128_si32(_mm_shuffle_epi8(quads, gather));
+        uint16_t n_mask = _mm_movemask_epi8(_mm_slli_epi16(code, 5));
+        memcpy(&read[i / 4], &packed, sizeof(packed));
+        memcpy(&read[SIZE_READ_PACKED + i / 8], &n_mask, sizeof(n_mask));
+    }
+    clear_padding(read, i);
+}
+
+__attribute__((target("sse4.2"))) static void encode_neighbour_sse42(const int8_t *data, uint8_t *neighbour)
+{
+    const __m128i mask = _mm_set1_epi8(3);
+    const __m128i pair_weights = _mm_set1_epi16(0x0401);
+    const __m128i quad_weights = _mm_set1_epi32(0x00100001);
+    const __m128i gather = _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    unsigned int i;
+    for (i = 0; i + 16 <= SIZE_NEIGHBOUR; i += 16) {
+        __m128i code = _mm_loadu_si128((const __m128i *)&data[i]);
+        __m128i pairs = _mm_maddubs_epi16(_mm_and_si128(code, mask), pair_weights);
+        __m128i quads = _mm_madd_epi16(pairs, quad_weights);
+        uint32_t packed = _mm_cvtsi128_si32(_mm_shuffle_epi8(quads, gather));
+        memcpy(&neighbour[i / 4], &packed, sizeof(packed));
+    }
+    pack_nucleotides_scalar(&data[i], SIZE_NEIGHBOUR - i, &neighbour[i / 4]);
+}
+
+__attribute__((target("sse4.2"))) static void encode_read_sse42(
+    const char *sequence, unsigned int size, uint8_t *read, uint8_t *read_rc)
+{
+    int8_t codes[SIZE_READ_CODES] __attribute__((aligned(32)));
+    int8_t codes_rc[2 * SIZE_READ_CODES] __attribute__((aligned(32)));
+    const __m128i mask = _mm_set1_epi8(3);
+    const __m128i lower_case = _mm_set1_epi8(0x20);
+    const __m128i n = _mm_set1_epi8('n');
+    const __m128i n_flag = _mm_set1_epi8(NUCLEOTIDE_N);
+    const __m128i complement = _mm_set1_epi8(COMPLEMENT);
+    const __m128i reverse = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    unsigned int i;
+
+    for (i = 0; i + 16 <= size; i += 16) {
+        __m128i chars = _mm_loadu_si128((const __m128i *)&sequence[i]);
+        __m128i code = _mm_and_si128(_mm_srli_epi16(chars, 1), mask);
+        __m128i is_n = _mm_cmpeq_epi8(_mm_or_si128(chars, lower_case), n);
+        _mm_store_si128((__m128i *)&codes[i], _mm_or_si128(code, _mm_and_si128(is_n, n_flag)));
+    }
+    for (; i < size; i++) {
+        codes[i] = ENCODE_NUCLEOTIDE(sequence[i]) | (IS_N(sequence[i]) ? NUCLEOTIDE_N : 0);
+    }
+    memset(&codes[size], 0, SIZE_READ_CODES - size);
+
+    for (i = 0; i < SIZE_READ_CODES; i += 16) {
+        __m128i code = _mm_load_si128((const __m128i *)&codes[SIZE_READ_CODES - 16 - i]);
+        _mm_store_si128((__m128i *)&codes_rc[i], _mm_xor_si128(_mm_shuffle_epi8(code, reverse), complement));
+    }
+    memset(&codes_rc[SIZE_READ_CODES], 0, SIZE_READ_CODES);
+
+    pack_read_sse42(codes, read);
+    pack_read_sse42(&codes_rc[SIZE_READ_CODES - size], read_rc);
+}
+
+__attribute__((target("avx2"))) static void encode_genome_sequence_avx2(const char *sequence, size_t size, int8_t *data)
+{
+    const __m256i mask = _mm256_set1_epi8(3);
+    const __m256i lower_case = _mm256_set1_epi8(0x20);
+    const __m256i n = _mm256_set1_epi8('n');
+    const __m256i nucleotide_n = _mm256_set1_epi8(NUCLEOTIDE_N);
+    size_t i;
+    for (i = 0; i + 32 <= size; i += 32) {
+        __m256i chars = _mm256_loadu_si256((const __m256i *)&sequence[i]);
+        __m256i code = _mm256_and_si256(_mm256_srli_epi16(chars, 1), mask);
+        __m256i is_n = _mm256_cmpeq_epi8(_mm256_or_si256(chars, lower_case), n);
+        _mm256_storeu_si256((__m256i *)&data[i], _mm256_blendv_epi8(code, nucleotide_n, is_n));
+    }
+    encode_genome_sequence_scalar(&sequence[i], size - i, &data[i]);
+}
+
+__attribute__((target("avx2"))) static void pack_read_avx2(const int8_t *codes, uint8_t *read)
+{
+    const __m256i mask = _mm256_set1_epi8(3);
+    const __m256i pair_weights = _mm256_set1_epi16(0x0401);
+    const __m256i quad_weights = _mm256_set1_epi32(0x00100001);
+    const __m256i gather = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 4, 8, 12, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m256i gather_lanes = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+    unsigned int i;
+    for (i = 0; i < SIZE_READ; i += 32) {
+        __m256i code = _mm256_loadu_si256((const __m256i *)&codes[i]);
+        __m256i pairs = _mm256_maddubs_epi16(_mm256_and_si256(code, mask), pair_weights);
+        __m256i quads = _mm256_madd_epi16(pairs, quad_weights);
+        __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(quads, gather), gather_lanes);
+        uint64_t packed = _mm_cvtsi128_si64(_mm256_castsi256_si128(bytes));
+        uint32_t n_mask = _mm256_movemask_epi8(_mm256_slli_epi16(code, 5));
+        memcpy(&read[i / 4], &packed, sizeof(packed));
+        memcpy(&read[SIZE_READ_PACKED + i / 8], &n_mask, sizeof(n_mask));
+    }
+    clear_padding(read, i);
+}
+
+__attribute__((target("avx2"))) static void encode_neighbour_avx2(const int8_t *data, uint8_t *neighbour)
+{
+    const __m256i mask = _mm256_set1_epi8(3);
+    const __m256i pair_weights = _mm256_set1_epi16(0x0401);
+    const __m256i quad_weights = _mm256_set1_epi32(0x00100001);
+    const __m256i gather = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 4, 8, 12, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m256i gather_lanes = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+    unsigned int i;
+    for (i = 0; i + 32 <= SIZE_NEIGHBOUR; i += 32) {
+        __m256i code = _mm256_loadu_si256((const __m256i *)&data[i]);
+        __m256i pairs = _mm256_maddubs_epi16(_mm256_and_si256(code, mask), pair_weights);
+        __m256i quads = _mm256_madd_epi16(pairs, quad_weights);
+        __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(quads, gather), gather_lanes);
+        uint64_t packed = _mm_cvtsi128_si64(_mm256_castsi256_si128(bytes));
+        memcpy(&neighbour[i / 4], &packed, sizeof(packed));
+    }
+    pack_nucleotides_scalar(&data[i], SIZE_NEIGHBOUR - i, &neighbour[i / 4]);
+}
+
+__attribute__((target("avx2"))) static void encode_read_avx2(const char *sequence, unsigned int size, uint8_t *read, uint8_t *read_rc)
+{
+    int8_t codes[SIZE_READ_CODES] __attribute__((aligned(32)));
+    int8_t codes_rc[2 * SIZE_READ_CODES] __attribute__((aligned(32)));
+    const __m256i mask = _mm256_set1_epi8(3);
+    const __m256i lower_case = _mm256_set1_epi8(0x20);
+    const __m256i n = _mm256_set1_epi8('n');
+    const __m256i n_flag = _mm256_set1_epi8(NUCLEOTIDE_N);
+    const __m256i complement = _mm256_set1_epi8(COMPLEMENT);
+    const __m256i reverse = _mm256_setr_epi8(
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    unsigned int i;
+
+    for (i = 0; i + 32 <= size; i += 32) {
+        __m256i chars = _mm256_loadu_si256((const __m256i *)&sequence[i]);
+        __m256i code = _mm256_and_si256(_mm256_srli_epi16(chars, 1), mask);
+        __m256i is_n = _mm256_cmpeq_epi8(_mm256_or_si256(chars, lower_case), n);
+        _mm256_store_si256((__m256i *)&codes[i], _mm256_or_si256(code, _mm256_and_si256(is_n, n_flag)));
+    }
+    for (; i < size; i++) {
+        codes[i] = ENCODE_NUCLEOTIDE(sequence[i]) | (IS_N(sequence[i]) ? NUCLEOTIDE_N : 0);
+    }
+    memset(&codes[size], 0, SIZE_READ_CODES - size);
+
+    for (i = 0; i < SIZE_READ_CODES; i += 32) {
+        __m256i code = _mm256_load_si256((const __m256i *)&codes[SIZE_READ_CODES - 32 - i]);
+        code = _mm256_permute2x128_si256(_mm256_shuffle_epi8(code, reverse), code, 0x01);
+        _mm256_store_si256((__m256i *)&codes_rc[i], _mm256_xor_si256(code, complement));
+    }
+    memset(&codes_rc[SIZE_READ_CODES], 0, SIZE_READ_CODES);
+
+    pack_read_avx2(codes, read);
+    pack_read_avx2(&codes_rc[SIZE_READ_CODES - size], read_rc);
+}
+
+#endif /* ENCODE_SIMD */
+
+typedef struct {
+    void (*genome_sequence)(const char *sequence, size_t size, int8_t *data);
+    void (*read)(const char *sequence, unsigned int size, uint8_t *read, uint8_t *read_rc);
+    void (*neighbour)(const int8_t *data, uint8_t *neighbour);
+    size_t (*lines)(const char *text, size_t size);
+} encode_kernel_t;
+
+static const encode_kernel_t scalar_kernel
+    = { encode_genome_sequence_scalar, encode_read_scalar, encode_neighbour_scalar, count_lines_scalar };
+#ifdef ENCODE_SIMD
+static const encode_kernel_t sse42_kernel
+    = { encode_genome_sequence_sse42, encode_read_sse42, encode_neighbour_sse42, count_lines_sse42 };
+static const encode_kernel_t avx2_kernel
+    = { encode_genome_sequence_avx2, encode_read_avx2, encode_neighbour_avx2, count_lines_avx2 };
+#endif
+
+/**
+ * @brief Select the kernel for the instruction sets supported by the processor the first time it is needed.
+ */
+static const encode_kernel_t *get_kernel()
+{
+    static const encode_kernel_t *kernel = NULL;
+    const encode_kernel_t *selected_kernel = __atomic_load_n(&kernel, __ATOMIC_RELAXED);
+    if (selected_kernel == NULL) {
+        selected_kernel = &scalar_kernel;
+#ifdef ENCODE_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            selected_kernel = &avx2_kernel;
+        } else if (__builtin_cpu_supports("sse4.2")) {
+            selected_kernel = &sse42_kernel;
+        }
+#endif
+        __atomic_store_n(&kernel, selected_kernel, __ATOMIC_RELAXED);
+    }
+    return selected_kernel;
+}
+
+void encode_genome_sequence(const char *sequence, size_t size, int8_t *data) { get_kernel()->genome_sequence(sequence, size, data); }
+
+void encode_read(const char *sequence, unsigned int size, uint8_t *read, uint8_t *read_rc)
+{
+    get_kernel()->read(sequence, size, read, read_rc);
+}
+
+void encode_seeds(const int8_t *data, size_t nb_seeds, int32_t *seed_codes)
+{
+    const uint32_t seed_mask = (uint32_t)((1ULL << (2 * SIZE_SEED)) - 1);
+    uint32_t code = 0;
+    unsigned int nb_nucleotides = 0; /* Since the last N */
+    for (unsigned int i = 0; i < SIZE_SEED - 1; i++) {
+        code = (code << 2) | (data[i] & 3);
+        nb_nucleotides = (data[i] < NUCLEOTIDE_N) ? nb_nucleotides + 1 : 0;
+    }
+    for (size_t i = 0; i < nb_seeds; i++) {
+        int8_t nucleotide = data[i + SIZE_SEED - 1];
+        code = ((code << 2) | (nucleotide & 3)) & seed_mask;
+        nb_nucleotides = (nucleotide < NUCLEOTIDE_N) ? nb_nucleotides + 1 : 0;
+        seed_codes[i] = (nb_nucleotides >= SIZE_SEED) ? (int32_t)code : -1;
+    }
+}
+
+void encode_neighbour(const int8_t *data, uint8_t *neighbour) { get_kernel()->neighbour(data, neighbour); }
+
+size_t count_lines(const char *text, size_t size) { return get_kernel()->lines(text, size); }
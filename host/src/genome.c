@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "encode.h"
 #include "genome.h"
 #include "parse_args.h"
 #include "upvc.h"
@@ -84,14 +85,10 @@ void genome_create()
                 strlen(&genome_file_line[1]) > MAX_SEQ_NAME_SIZE ? MAX_SEQ_NAME_SIZE : strlen(&genome_file_line[1]));
             genome.nb_seq++;
         } else {
-            for (unsigned int i = 0; i < strlen(genome_file_line) - 1; i++) {
-                if (genome_file_line[i] != 'N') { /* A -> 0, C -> 1, G -> 3, T -> 2 */
-                    genome.data[current_data_idx++] = (((int)genome_file_line[i]) >> 1) & 3;
-                } else {
-                    genome.data[current_data_idx++] = 4;
-                }
-                genome.len_seq[genome.nb_seq - 1]++;
-            }
+            size_t line_size = strlen(genome_file_line) - 1;
+            encode_genome_sequence(genome_file_line, line_size, &genome.data[current_data_idx]);
+            current_data_idx += line_size;
+            genome.len_seq[genome.nb_seq - 1] += line_size;
         }
     }
     fclose(genome_file);
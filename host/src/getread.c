@@ -3,22 +3,162 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
 
 #include "common.h"
+#include "encode.h"
 #include "getread.h"
+#include "index.h"
+#include "parse_args.h"
+#include "prefilter.h"
 #include "upvc.h"
 
 #define MAX_SEQ_SIZE (512)
 #define MAX_BUF_SIZE (1024)
 
+#define MIN(a, b) ((a) > (b) ? (b) : (a))
+
 static int nb_reads[NB_READS_BUFFER];
-static int8_t *reads_buffers[NB_READS_BUFFER];
+static uint8_t *reads_buffers[NB_READS_BUFFER];
 #define PASS(pass_id) (pass_id % NB_READS_BUFFER)
 
+/**
+ * @brief An input file of reads.
+ *
+ * Compressed files are decompressed in a window that holds at least the records of the next pass,
+ * the window is then parsed in place as if it was a memory-mapped file.
+ *
+ * @var f                The file, used to parse it when it could not be memory-mapped.
+ * @var data             The memory-mapped content of the file or the decompression window (NULL if none of them is used).
+ * @var size             Size of the memory-mapped content.
+ * @var pos              Offset of the next record to parse in the memory-mapped content.
+ * @var window           Decompression window of compressed files (NULL for uncompressed files).
+ * @var window_capacity  Allocated size of the decompression window.
+ * @var gz               Plain gzip stream (NULL for other files).
+ * @var bgzf             Memory-mapped BGZF file (NULL for other files).
+ * @var bgzf_size        Size of the memory-mapped BGZF file.
+ * @var bgzf_pos         Offset of the next BGZF block to decompress.
+ * @var record_lines     Number of lines of the records of the file, from its first character: 2 for the records written
+ *                       between rounds (starting with '>'), 4 for FASTQ (0 until the beginning of the file is read).
+ */
+typedef struct {
+    FILE *f;
+    const char *data;
+    size_t size;
+    size_t pos;
+    char *window;
+    size_t window_capacity;
+    gzFile gz;
+    const uint8_t *bgzf;
+    size_t bgzf_size;
+    size_t bgzf_pos;
+    unsigned int record_lines;
+} input_file_t;
+
+static input_file_t input_files[2];
+
+#define GET_READS_THREAD (8)
+#define GET_READS_THREAD_SLAVE (GET_READS_THREAD - 1)
+
+/**
+ * @brief A byte range of a memory-mapped input file, parsed by one thread.
+ *
+ * @var begin         Beginning of the range (not necessarily the beginning of a record).
+ * @var end           End of the range.
+ * @var start         Offset of the first record starting in the range.
+ * @var next          Offset following the last record starting in the range.
+ * @var nb_records    Number of records starting in the range.
+ * @var first_record  Index in the pass of the first record starting in the range.
+ */
+typedef struct {
+    size_t begin;
+    size_t end;
+    size_t start;
+    size_t next;
+    unsigned int nb_records;
+    unsigned int first_record;
+} chunk_t;
+
+static chunk_t chunks[2][GET_READS_THREAD];
+static size_t next_pos[2];
+static double record_size[2];
+static unsigned int nb_pairs;
+static uint8_t *reads_buffer_shared;
+
+static unsigned int nb_kept_pairs[GET_READS_THREAD];
+static prefilter_stats_t prefilter_stats[GET_READS_THREAD];
+static pthread_barrier_t barrier;
+static pthread_t thread_id[GET_READS_THREAD_SLAVE];
+static bool stop_threads;
+static void (*chunk_fct)(unsigned int);
+
+#define GZIP_ID1 (0x1f)
+#define GZIP_ID2 (0x8b)
+#define GZIP_FLAG_EXTRA (0x04)
+#define BGZF_HEADER_SIZE (18)
+#define BGZF_FOOTER_SIZE (8)
+#define BGZF_MAX_BLOCKS_PER_FILL (1024)
+
+/**
+ * @brief A BGZF block to be decompressed in the window of an input file.
+ *
+ * @var in           The input file.
+ * @var data         Deflate data of the block.
+ * @var data_size    Size of the deflate data.
+ * @var window_pos   Where to decompress the block in the window.
+ * @var size         Size of the decompressed block.
+ */
+typedef struct {
+    input_file_t *in;
+    const uint8_t *data;
+    size_t data_size;
+    size_t window_pos;
+    size_t size;
+} bgzf_block_t;
+
+static bgzf_block_t bgzf_blocks[BGZF_MAX_BLOCKS_PER_FILL];
+static unsigned int nb_bgzf_blocks;
+
+/**
+ * @brief Plan of the passes, built by a prescan counting the lines of memory-mapped inputs.
+ *
+ * @var block_lines       Number of lines ending in each block of PRESCAN_BLOCK_SIZE bytes of the file.
+ * @var pass_offsets      Offset of the first record of each pass, followed by the end of the last pass (NULL if not planned).
+ * @var nb_planned_pairs  Number of pairs of reads of the inputs.
+ * @var nb_planned_passes Number of passes needed to read all the pairs.
+ */
+#define PRESCAN_BLOCK_SIZE (256 * 1024)
+static size_t *block_lines[2];
+static size_t *pass_offsets[2];
+static size_t nb_planned_pairs;
+static unsigned int nb_planned_passes;
+
+static uint64_t parsed_bytes;
+static uint64_t nb_parsed_pairs;
+static double parse_time;
+
+/**
+ * @brief Number of passes of the inputs entirely dropped by the pre-filter since the beginning of the inputs: their pairs
+ * are replaced by the ones of the next passes, a pass without any read being the end of the inputs.
+ */
+static unsigned int nb_dropped_passes;
+
+/**
+ * @brief Cache of the encoded reads of the first run, read back by the next runs instead of parsing the inputs again.
+ * Each pass is stored as its number of reads followed by its reads buffer.
+ */
+static FILE *reads_cache;
+static bool reads_cache_complete;
+
 /**
  * @brief Parse the file "f" to get the next read in the file and its pair.
  *
@@ -28,9 +168,8 @@ static int8_t *reads_buffers[NB_READS_BUFFER];
  *
  * @return The size of the read.
  */
-static int get_seq_fast_AQ(FILE *f, int8_t *read1, int8_t *read2)
+static int get_seq_fast_AQ(FILE *f, uint8_t *read1, uint8_t *read2)
 {
-    static const int invnt[4] = { 2, 3, 0, 1 };
     int offset = 0;
     char comment[MAX_BUF_SIZE];
     char sequence_buffer[MAX_SEQ_SIZE];
@@ -48,15 +187,7 @@ static int get_seq_fast_AQ(FILE *f, int8_t *read1, int8_t *read2)
     if (comment[1] == '>') {
         sscanf(&comment[2], "%d", &offset);
     }
-    int i;
-    for (i = 0; i < SIZE_READ - offset; i++) {
-        read1[i] = (((int)sequence_buffer[i]) >> 1) & 3;
-        read2[SIZE_READ - i - 1 - offset] = invnt[read1[i]];
-    }
-    for (; i < SIZE_READ; i++) {
-        read1[i] = 0;
-        read2[i] = 0;
-    }
+    encode_read(sequence_buffer, SIZE_READ - offset, read1, read2);
 
     if (comment[0] == '>') {
         return SIZE_READ;
@@ -70,51 +201,837 @@ static int get_seq_fast_AQ(FILE *f, int8_t *read1, int8_t *read2)
     return SIZE_READ;
 }
 
-void get_reads(FILE *fpe1, FILE *fpe2, unsigned int pass_id)
+/**
+ * @brief Get the next line of a memory-mapped file, without copying it.
+ *
+ * @return A pointer on the line (not terminated by '\0') or NULL at the end of the file.
+ */
+static const char *get_line_mmap(input_file_t *in, size_t *len)
+{
+    if (in->pos >= in->size) {
+        return NULL;
+    }
+    const char *line = &in->data[in->pos];
+    const char *end = memchr(line, '\n', in->size - in->pos);
+    *len = (end == NULL) ? in->size - in->pos : (size_t)(end - line);
+    in->pos += *len;
+    if (in->pos < in->size) { /* Skip '\n' */
+        in->pos++;
+    }
+    return line;
+}
+
+/**
+ * @brief Same as "get_seq_fast_AQ" but parsing the record in place in the memory-mapped file.
+ */
+static int get_seq_fast_AQ_mmap(input_file_t *in, uint8_t *read1, uint8_t *read2)
+{
+    int offset = 0;
+    size_t comment_len, sequence_len, len;
+
+    const char *comment = get_line_mmap(in, &comment_len); /* Commentary */
+    if (comment == NULL) {
+        return -1;
+    }
+    const char *sequence = get_line_mmap(in, &sequence_len); /* Sequence */
+    if (sequence == NULL) {
+        return -1;
+    }
+
+    /* If the comment start with ">>14"
+     * it means that we need the skip the first 14 characters of the read.
+     */
+    if (comment_len > 1 && comment[1] == '>') {
+        for (size_t i = 2; i < comment_len && comment[i] >= '0' && comment[i] <= '9'; i++) {
+            offset = offset * 10 + comment[i] - '0';
+        }
+    }
+    /* Do not read further than the line if the sequence is shorter than expected */
+    if (sequence_len < (size_t)(SIZE_READ - offset)) {
+        offset = SIZE_READ - sequence_len;
+    }
+    encode_read(sequence, SIZE_READ - offset, read1, read2);
+
+    if (comment[0] == '>') {
+        return SIZE_READ;
+    }
+    if (get_line_mmap(in, &len) == NULL) { /* Commentary */
+        return -1;
+    }
+    if (get_line_mmap(in, &len) == NULL) { /* Line with sequence quality information (unused) */
+        return -1;
+    }
+    return SIZE_READ;
+}
+
+/**
+ * @brief Go over the record at the current position of the memory-mapped file without encoding it.
+ *
+ * @return Whether a complete record has been found.
+ */
+static bool skip_record_mmap(input_file_t *in)
+{
+    size_t len;
+    const char *comment = get_line_mmap(in, &len);
+    if (comment == NULL || get_line_mmap(in, &len) == NULL) {
+        return false;
+    }
+    if (comment[0] == '>') {
+        return true;
+    }
+    return get_line_mmap(in, &len) != NULL && get_line_mmap(in, &len) != NULL;
+}
+
+/**
+ * @brief Find the first record starting at or after "pos" in the memory-mapped file.
+ *
+ * A FASTQ record is a line starting with '@' whose following line but one starts with '+' (a quality line starting
+ * with '@' is followed by a comment and a sequence). Records written between rounds are 2 lines starting with '>', a
+ * character which is also a quality score: it is only a record start in the files of these records.
+ */
+static size_t resync_mmap(const input_file_t *in, size_t pos)
+{
+    input_file_t cursor = *in;
+    size_t len;
+
+    cursor.pos = pos;
+    if (pos != 0 && pos < in->size && in->data[pos - 1] != '\n') {
+        get_line_mmap(&cursor, &len);
+    }
+    while (cursor.pos < in->size) {
+        size_t line_pos = cursor.pos;
+        const char *line = get_line_mmap(&cursor, &len);
+        if (in->record_lines == 2) {
+            if (line[0] == '>') {
+                return line_pos;
+            }
+        } else if (line[0] == '@') {
+            input_file_t lookahead = cursor;
+            if (get_line_mmap(&lookahead, &len) != NULL) {
+                const char *separator = get_line_mmap(&lookahead, &len);
+                if (separator != NULL && separator[0] == '+') {
+                    return line_pos;
+                }
+            }
+        }
+    }
+    return in->size;
+}
+
+static int get_seq(input_file_t *in, uint8_t *read1, uint8_t *read2)
+{
+    if (in->data != NULL) {
+        return get_seq_fast_AQ_mmap(in, read1, read2);
+    }
+    return get_seq_fast_AQ(in->f, read1, read2);
+}
+
+/**
+ * @brief Count the records starting in the chunk of each file given to the thread.
+ */
+static void count_records_in_chunk(unsigned int thread_id)
+{
+    for (unsigned int each_file = 0; each_file < 2; each_file++) {
+        input_file_t cursor = input_files[each_file];
+        chunk_t *chunk = &chunks[each_file][thread_id];
+
+        chunk->start = (chunk->begin == cursor.pos) ? chunk->begin : resync_mmap(&cursor, chunk->begin);
+        chunk->nb_records = 0;
+        cursor.pos = chunk->start;
+        while (cursor.pos < chunk->end && skip_record_mmap(&cursor)) {
+            chunk->nb_records++;
+        }
+        chunk->next = cursor.pos;
+    }
+}
+
+/**
+ * @brief Encode the records starting in the chunk of each file given to the thread.
+ * Record "i" of the pass is stored at index "4 * i" in the reads buffer for the first file, "4 * i + 2" for the second one.
+ */
+static void encode_records_in_chunk(unsigned int thread_id)
+{
+    for (unsigned int each_file = 0; each_file < 2; each_file++) {
+        input_file_t cursor = input_files[each_file];
+        chunk_t *chunk = &chunks[each_file][thread_id];
+
+        cursor.pos = chunk->start;
+        for (unsigned int each_record = 0; each_record < chunk->nb_records; each_record++) {
+            unsigned int num_pair = chunk->first_record + each_record;
+            if (num_pair >= nb_pairs) {
+                break;
+            }
+            uint8_t *read = &reads_buffer_shared[(num_pair * 4 + each_file * 2) * SIZE_READ_IN_BYTES];
+            get_seq_fast_AQ_mmap(&cursor, read, read + SIZE_READ_IN_BYTES);
+        }
+    }
+}
+
+/**
+ * @brief Pre-filter the pairs of the slice of the reads buffer given to the thread, keeping them at the beginning of the
+ * slice.
+ */
+static void prefilter_pairs_in_chunk(unsigned int thread_id)
+{
+    unsigned int first_pair = (unsigned int)((uint64_t)nb_pairs * thread_id / GET_READS_THREAD);
+    unsigned int last_pair = (unsigned int)((uint64_t)nb_pairs * (thread_id + 1) / GET_READS_THREAD);
+    memset(&prefilter_stats[thread_id], 0, sizeof(prefilter_stats_t));
+    nb_kept_pairs[thread_id] = prefilter_pairs(
+        &reads_buffer_shared[first_pair * 4 * SIZE_READ_IN_BYTES], last_pair - first_pair, &prefilter_stats[thread_id]);
+}
+
+static void *get_reads_thread_fct(void *arg)
+{
+    unsigned int thread_id = (unsigned int)(uintptr_t)arg;
+    pthread_barrier_wait(&barrier);
+    while (!stop_threads) {
+        chunk_fct(thread_id);
+        pthread_barrier_wait(&barrier);
+        pthread_barrier_wait(&barrier);
+    }
+    return NULL;
+}
+
+static void run_on_all_threads(void (*fct)(unsigned int))
+{
+    chunk_fct = fct;
+    pthread_barrier_wait(&barrier);
+    fct(GET_READS_THREAD_SLAVE);
+    pthread_barrier_wait(&barrier);
+}
+
+/**
+ * @brief Parse the header of the BGZF block at "pos".
+ *
+ * @return The size of the block, 0 if it is not a BGZF block.
+ */
+static size_t bgzf_block_size(const uint8_t *bgzf, size_t bgzf_size, size_t pos)
+{
+    if (bgzf_size - pos < BGZF_HEADER_SIZE || bgzf[pos] != GZIP_ID1 || bgzf[pos + 1] != GZIP_ID2
+        || !(bgzf[pos + 3] & GZIP_FLAG_EXTRA)) {
+        return 0;
+    }
+    size_t extra_len = bgzf[pos + 10] | (bgzf[pos + 11] << 8);
+    size_t extra_pos = pos + 12;
+    size_t extra_end = extra_pos + extra_len;
+    if (extra_end > bgzf_size) {
+        return 0;
+    }
+    while (extra_pos + 4 <= extra_end) {
+        size_t subfield_len = bgzf[extra_pos + 2] | (bgzf[extra_pos + 3] << 8);
+        if (bgzf[extra_pos] == 'B' && bgzf[extra_pos + 1] == 'C' && subfield_len == 2) {
+            size_t block_size = (bgzf[extra_pos + 4] | (bgzf[extra_pos + 5] << 8)) + 1;
+            return (pos + block_size <= bgzf_size) ? block_size : 0;
+        }
+        extra_pos += 4 + subfield_len;
+    }
+    return 0;
+}
+
+/**
+ * @brief Decompress the BGZF blocks of the fill given to the thread.
+ */
+static void inflate_bgzf_blocks(unsigned int thread_id)
+{
+    z_stream strm = { .zalloc = Z_NULL, .zfree = Z_NULL, .opaque = Z_NULL };
+    assert(inflateInit2(&strm, -MAX_WBITS) == Z_OK);
+    for (unsigned int each_block = thread_id; each_block < nb_bgzf_blocks; each_block += GET_READS_THREAD) {
+        bgzf_block_t *block = &bgzf_blocks[each_block];
+        strm.next_in = (uint8_t *)block->data;
+        strm.avail_in = block->data_size;
+        strm.next_out = (uint8_t *)&block->in->window[block->window_pos];
+        strm.avail_out = block->size;
+        int ret = inflate(&strm, Z_FINISH);
+        if (ret != Z_STREAM_END || strm.avail_out != 0) {
+            ERROR_EXIT(ERR_GETREAD_DECOMPRESSION_FAILED, "%s: corrupted BGZF block", __func__);
+        }
+        assert(inflateReset(&strm) == Z_OK);
+    }
+    inflateEnd(&strm);
+}
+
+static void window_reserve(input_file_t *in, size_t capacity)
+{
+    if (in->window_capacity < capacity) {
+        in->window_capacity = capacity;
+        in->window = (char *)realloc(in->window, capacity);
+        assert(in->window != NULL);
+        in->data = in->window;
+    }
+}
+
+/**
+ * @brief Decompress the input files until their window holds at least "needed" bytes to parse (or the end of the file).
+ * BGZF blocks are independent and are decompressed in parallel.
+ */
+static void input_files_fill(const size_t needed[2])
+{
+    nb_bgzf_blocks = 0;
+    for (unsigned int each_file = 0; each_file < 2; each_file++) {
+        input_file_t *in = &input_files[each_file];
+        if (in->window == NULL || in->size - in->pos >= needed[each_file]) {
+            continue;
+        }
+
+        /* Keep the data left to parse at the beginning of the window */
+        memmove(in->window, &in->window[in->pos], in->size - in->pos);
+        in->size -= in->pos;
+        in->pos = 0;
+        window_reserve(in, needed[each_file] + MAX_BUF_SIZE);
+
+        if (in->gz != NULL) {
+            while (in->size < needed[each_file]) {
+                int size_read = gzread(in->gz, &in->window[in->size], in->window_capacity - in->size);
+                if (size_read < 0) {
+                    ERROR_EXIT(ERR_GETREAD_DECOMPRESSION_FAILED, "%s: %s", __func__, gzerror(in->gz, &size_read));
+                } else if (size_read == 0) {
+                    break;
+                }
+                in->size += size_read;
+            }
+            continue;
+        }
+
+        while (in->size < needed[each_file] && in->bgzf_pos < in->bgzf_size && nb_bgzf_blocks < BGZF_MAX_BLOCKS_PER_FILL) {
+            size_t block_size = bgzf_block_size(in->bgzf, in->bgzf_size, in->bgzf_pos);
+            if (block_size < BGZF_HEADER_SIZE + BGZF_FOOTER_SIZE) {
+                ERROR_EXIT(ERR_GETREAD_DECOMPRESSION_FAILED, "%s: corrupted BGZF block header", __func__);
+            }
+            const uint8_t *footer = &in->bgzf[in->bgzf_pos + block_size - 4];
+            bgzf_block_t *block = &bgzf_blocks[nb_bgzf_blocks++];
+            block->in = in;
+            block->data = &in->bgzf[in->bgzf_pos + BGZF_HEADER_SIZE];
+            block->data_size = block_size - BGZF_HEADER_SIZE - BGZF_FOOTER_SIZE;
+            block->size = footer[0] | (footer[1] << 8) | (footer[2] << 16) | ((size_t)footer[3] << 24);
+            block->window_pos = in->size;
+            in->size += block->size;
+            in->bgzf_pos += block_size;
+        }
+        window_reserve(in, in->size);
+    }
+
+    if (nb_bgzf_blocks != 0) {
+        run_on_all_threads(inflate_bgzf_blocks);
+        /* The fill may have been limited by the number of blocks */
+        input_files_fill(needed);
+    }
+}
+
+static bool input_file_at_end(const input_file_t *in, size_t pos)
+{
+    if (pos < in->size) {
+        return false;
+    } else if (in->gz != NULL) {
+        return gzeof(in->gz);
+    }
+    return in->bgzf_pos >= in->bgzf_size;
+}
+
+/**
+ * @brief Split the next records of both files in byte ranges, one per thread, until the ranges hold enough records to
+ * fill the pass (or reach the end of the files). Returns the number of pairs of the pass.
+ * When the passes are planned, the ranges of the pass are known and the pass does not need to follow the previous one.
+ */
+static unsigned int split_in_chunks(unsigned int pass_id)
+{
+    unsigned int nb_pairs_per_pass = MAX_READS_BUFFER / 4;
+    unsigned int nb_records[2];
+    double span_factor = 1.05;
+
+    while (true) {
+        size_t span[2];
+        for (unsigned int each_file = 0; each_file < 2; each_file++) {
+            if (pass_offsets[each_file] == NULL) {
+                span[each_file] = (size_t)(record_size[each_file] * nb_pairs_per_pass * span_factor) + MAX_BUF_SIZE;
+            } else if (pass_id < nb_planned_passes) {
+                input_files[each_file].pos = pass_offsets[each_file][pass_id];
+                span[each_file] = pass_offsets[each_file][pass_id + 1] - pass_offsets[each_file][pass_id];
+            } else {
+                input_files[each_file].pos = input_files[each_file].size;
+                span[each_file] = 0;
+            }
+        }
+        input_files_fill(span);
+        for (unsigned int each_file = 0; each_file < 2; each_file++) {
+            /* The first fill of a file starts at its beginning */
+            input_file_t *in = &input_files[each_file];
+            if (in->record_lines == 0 && in->size != 0) {
+                in->record_lines = in->data[0] == '>' ? 2 : 4;
+            }
+        }
+
+        for (unsigned int each_file = 0; each_file < 2; each_file++) {
+            input_file_t *in = &input_files[each_file];
+            size_t region_end = (in->size - in->pos > span[each_file]) ? in->pos + span[each_file] : in->size;
+            for (unsigned int each_thread = 0; each_thread < GET_READS_THREAD; each_thread++) {
+                chunks[each_file][each_thread].begin = in->pos + (region_end - in->pos) * each_thread / GET_READS_THREAD;
+                chunks[each_file][each_thread].end = in->pos + (region_end - in->pos) * (each_thread + 1) / GET_READS_THREAD;
+            }
+        }
+
+        run_on_all_threads(count_records_in_chunk);
+
+        bool enough_records = true;
+        for (unsigned int each_file = 0; each_file < 2; each_file++) {
+            nb_records[each_file] = 0;
+            for (unsigned int each_thread = 0; each_thread < GET_READS_THREAD; each_thread++) {
+                chunks[each_file][each_thread].first_record = nb_records[each_file];
+                nb_records[each_file] += chunks[each_file][each_thread].nb_records;
+            }
+            if (pass_offsets[each_file] == NULL && nb_records[each_file] < nb_pairs_per_pass
+                && !input_file_at_end(&input_files[each_file], chunks[each_file][GET_READS_THREAD - 1].end)) {
+                enough_records = false;
+            }
+        }
+        if (enough_records) {
+            break;
+        }
+        span_factor *= 2.0;
+    }
+
+    /* A file with less records than a pass is at its end, the other one must be too */
+    if (nb_records[0] != nb_records[1] && MIN(nb_records[0], nb_records[1]) < nb_pairs_per_pass) {
+        ERROR_EXIT(ERR_GETREAD_UNPAIRED_READS, "The PE%u input ends before the PE%u input, after %lu pairs",
+            nb_records[0] < nb_records[1] ? 1 : 2, nb_records[0] < nb_records[1] ? 2 : 1,
+            nb_parsed_pairs + MIN(nb_records[0], nb_records[1]));
+    }
+    unsigned int nb_pairs_in_pass = MIN(nb_records[0], nb_pairs_per_pass);
+    for (unsigned int each_file = 0; each_file < 2; each_file++) {
+        /* If every record found is used, the next pass starts after the last one */
+        next_pos[each_file] = input_files[each_file].pos;
+        for (unsigned int each_thread = 0; each_thread < GET_READS_THREAD; each_thread++) {
+            chunk_t *chunk = &chunks[each_file][each_thread];
+            if (chunk->first_record + chunk->nb_records > nb_pairs_in_pass) {
+                /* Otherwise it starts at the first record left, in the first chunk holding records left */
+                input_file_t cursor = input_files[each_file];
+                cursor.pos = chunk->start;
+                for (unsigned int each_record = chunk->first_record; each_record < nb_pairs_in_pass; each_record++) {
+                    assert(skip_record_mmap(&cursor));
+                }
+                next_pos[each_file] = cursor.pos;
+                break;
+            }
+            if (chunk->nb_records != 0) {
+                next_pos[each_file] = chunk->next;
+            }
+        }
+    }
+    return nb_pairs_in_pass;
+}
+
+static int get_reads_parallel(uint8_t *reads_buffer, unsigned int pass_id)
+{
+    nb_pairs = split_in_chunks(pass_id);
+    reads_buffer_shared = reads_buffer;
+
+    run_on_all_threads(encode_records_in_chunk);
+
+    for (unsigned int each_file = 0; each_file < 2; each_file++) {
+        input_file_t *in = &input_files[each_file];
+        if (nb_pairs != 0) {
+            record_size[each_file] = (double)(next_pos[each_file] - in->pos) / nb_pairs;
+        }
+        parsed_bytes += next_pos[each_file] - in->pos;
+        in->pos = next_pos[each_file];
+    }
+    return nb_pairs * 4;
+}
+
+/**
+ * @brief Drop the pairs rejected by the pre-filter from the reads buffer.
+ *
+ * @return The number of reads left.
+ */
+static int prefilter_reads_buffer(uint8_t *reads_buffer, int nb_read)
+{
+    nb_pairs = nb_read / 4;
+    reads_buffer_shared = reads_buffer;
+
+    run_on_all_threads(prefilter_pairs_in_chunk);
+
+    unsigned int nb_pairs_left = 0;
+    for (unsigned int each_thread = 0; each_thread < GET_READS_THREAD; each_thread++) {
+        unsigned int first_pair = (unsigned int)((uint64_t)nb_pairs * each_thread / GET_READS_THREAD);
+        if (nb_pairs_left != first_pair) {
+            memmove(&reads_buffer[nb_pairs_left * 4 * SIZE_READ_IN_BYTES], &reads_buffer[first_pair * 4 * SIZE_READ_IN_BYTES],
+                nb_kept_pairs[each_thread] * 4 * SIZE_READ_IN_BYTES);
+        }
+        nb_pairs_left += nb_kept_pairs[each_thread];
+        prefilter_add_stats(&prefilter_stats[each_thread]);
+    }
+    return nb_pairs_left * 4;
+}
+
+static bool is_gzip(FILE *f)
+{
+    uint8_t magic[2];
+    return pread(fileno(f), magic, sizeof(magic), 0) == sizeof(magic) && magic[0] == GZIP_ID1 && magic[1] == GZIP_ID2;
+}
+
+static gzFile open_gzip(FILE *f)
+{
+    int fd = dup(fileno(f));
+    assert(fd != -1);
+    assert(lseek(fd, 0, SEEK_SET) == 0);
+    gzFile gz = gzdopen(fd, "rb");
+    assert(gz != NULL);
+    gzbuffer(gz, 1 << 20);
+    return gz;
+}
+
+static void reads_cache_write(uint8_t *reads_buffer, int nb_read)
+{
+    xfer_file((uint8_t *)&nb_read, sizeof(nb_read), reads_cache, xfer_write);
+    if (nb_read != 0) {
+        xfer_file(reads_buffer, nb_read * SIZE_READ_IN_BYTES, reads_cache, xfer_write);
+    }
+}
+
+static int reads_cache_read(uint8_t *reads_buffer)
+{
+    int nb_read = 0;
+    if (fread(&nb_read, sizeof(nb_read), 1, reads_cache) != 1) {
+        return 0;
+    }
+    if (nb_read != 0) {
+        xfer_file(reads_buffer, nb_read * SIZE_READ_IN_BYTES, reads_cache, xfer_read);
+    }
+    return nb_read;
+}
+
+static size_t prescan_nb_blocks(const input_file_t *in) { return (in->size + PRESCAN_BLOCK_SIZE - 1) / PRESCAN_BLOCK_SIZE; }
+
+/**
+ * @brief Count the lines of the blocks of each file given to the thread.
+ */
+static void count_lines_in_blocks(unsigned int thread_id)
+{
+    for (unsigned int each_file = 0; each_file < 2; each_file++) {
+        const input_file_t *in = &input_files[each_file];
+        size_t nb_blocks = prescan_nb_blocks(in);
+        for (size_t each_block = thread_id; each_block < nb_blocks; each_block += GET_READS_THREAD) {
+            size_t block_pos = each_block * PRESCAN_BLOCK_SIZE;
+            block_lines[each_file][each_block] = count_lines(&in->data[block_pos], MIN(PRESCAN_BLOCK_SIZE, in->size - block_pos));
+        }
+    }
+}
+
+/**
+ * @brief Get the offset of the line "line" (the offset following its previous '\n').
+ * The lines are looked for in increasing order, from the block "*block" which begins with the line "*first_line".
+ */
+static size_t line_offset(unsigned int each_file, size_t line, size_t *block, size_t *first_line)
+{
+    const input_file_t *in = &input_files[each_file];
+    size_t nb_blocks = prescan_nb_blocks(in);
+    if (line == 0) {
+        return 0;
+    }
+    while (*block < nb_blocks && *first_line + block_lines[each_file][*block] < line) {
+        *first_line += block_lines[each_file][*block];
+        (*block)++;
+    }
+    if (*block == nb_blocks) {
+        return in->size;
+    }
+    const char *pos = &in->data[*block * PRESCAN_BLOCK_SIZE];
+    for (size_t each_line = *first_line; each_line < line; each_line++) {
+        pos = (const char *)memchr(pos, '\n', &in->data[in->size] - pos) + 1;
+    }
+    return pos - in->data;
+}
+
+/**
+ * @brief Count the pairs of reads of memory-mapped inputs and find where each pass begins in the files.
+ * FASTQ records are 4 lines long, the records written between rounds are 2 lines long.
+ */
+static void plan_passes()
+{
+    unsigned int nb_pairs_per_pass = MAX_READS_BUFFER / 4;
+    size_t lines_per_record[2];
+    size_t nb_records[2];
+    double start_time = my_clock();
+
+    for (unsigned int each_file = 0; each_file < 2; each_file++) {
+        block_lines[each_file] = (size_t *)malloc(prescan_nb_blocks(&input_files[each_file]) * sizeof(size_t));
+        assert(block_lines[each_file] != NULL);
+    }
+    run_on_all_threads(count_lines_in_blocks);
+
+    for (unsigned int each_file = 0; each_file < 2; each_file++) {
+        const input_file_t *in = &input_files[each_file];
+        size_t nb_lines = (in->size != 0 && in->data[in->size - 1] != '\n') ? 1 : 0;
+        for (size_t each_block = 0; each_block < prescan_nb_blocks(in); each_block++) {
+            nb_lines += block_lines[each_file][each_block];
+        }
+        lines_per_record[each_file] = (in->size != 0 && in->data[0] == '>') ? 2 : 4;
+        nb_records[each_file] = nb_lines / lines_per_record[each_file];
+    }
+    if (nb_records[0] != nb_records[1]) {
+        ERROR_EXIT(ERR_GETREAD_UNPAIRED_READS, "The PE1 input has %lu reads and the PE2 input %lu reads", nb_records[0],
+            nb_records[1]);
+    }
+    nb_planned_pairs = nb_records[0];
+
+    nb_planned_passes = (nb_planned_pairs + nb_pairs_per_pass - 1) / nb_pairs_per_pass;
+    for (unsigned int each_file = 0; each_file < 2; each_file++) {
+        size_t block = 0, first_line = 0;
+        pass_offsets[each_file] = (size_t *)malloc((nb_planned_passes + 1) * sizeof(size_t));
+        assert(pass_offsets[each_file] != NULL);
+        for (unsigned int each_pass = 0; each_pass <= nb_planned_passes; each_pass++) {
+            size_t first_pair = MIN((size_t)each_pass * nb_pairs_per_pass, nb_planned_pairs);
+            pass_offsets[each_file][each_pass]
+                = line_offset(each_file, first_pair * lines_per_record[each_file], &block, &first_line);
+        }
+        free(block_lines[each_file]);
+        block_lines[each_file] = NULL;
+    }
+
+    printf("get_reads:\n"
+           "\tprescan: %lu pairs, %u passes in %lf s\n",
+        nb_planned_pairs, nb_planned_passes, my_clock() - start_time);
+}
+
+static void input_file_init(input_file_t *in, FILE *f)
+{
+    struct stat st;
+
+    memset(in, 0, sizeof(*in));
+    in->f = f;
+
+    /* Files that cannot be mapped (pipes, empty files, ...) are parsed with the stdio functions */
+    fflush(f);
+    if (fstat(fileno(f), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        return;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+    if (data == MAP_FAILED) {
+        return;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    if (!is_gzip(f)) {
+        in->data = (const char *)data;
+        in->size = st.st_size;
+    } else if (bgzf_block_size((const uint8_t *)data, st.st_size, 0) != 0) {
+        in->bgzf = (const uint8_t *)data;
+        in->bgzf_size = st.st_size;
+        window_reserve(in, MAX_BUF_SIZE);
+    } else {
+        munmap(data, st.st_size);
+        in->gz = open_gzip(f);
+        window_reserve(in, MAX_BUF_SIZE);
+    }
+}
+
+static void input_file_rewind(input_file_t *in)
+{
+    in->pos = 0;
+    fseek(in->f, 0, SEEK_SET);
+    if (in->window != NULL) {
+        in->size = 0;
+        in->bgzf_pos = 0;
+        if (in->gz != NULL) {
+            gzrewind(in->gz);
+        }
+    }
+}
+
+static void input_file_free(input_file_t *in)
+{
+    if (in->gz != NULL) {
+        gzclose(in->gz);
+    } else if (in->bgzf != NULL) {
+        munmap((void *)in->bgzf, in->bgzf_size);
+    } else if (in->data != NULL) {
+        munmap((void *)in->data, in->size);
+    }
+    free(in->window);
+    memset(in, 0, sizeof(*in));
+}
+
+void get_reads_init(FILE *fpe1, FILE *fpe2, bool cache_reads)
+{
+    if (fpe1 == fpe2) {
+        /* Interleaved pairs: the records are read alternately for each file from the same stream, without seeking */
+        memset(input_files, 0, sizeof(input_files));
+        input_files[0].f = fpe1;
+        input_files[1].f = fpe2;
+    } else {
+        input_file_init(&input_files[0], fpe1);
+        input_file_init(&input_files[1], fpe2);
+    }
+    parsed_bytes = 0ULL;
+    nb_parsed_pairs = 0;
+    parse_time = 0.0;
+    nb_dropped_passes = 0;
+
+    reads_cache_complete = false;
+    reads_cache = NULL;
+    if (cache_reads) {
+        char filename[FILENAME_MAX];
+        sprintf(filename, "%s_reads_cache.bin", get_input_path());
+        reads_cache = fopen(filename, "w+");
+        CHECK_FILE(reads_cache, filename);
+        assert(unlink(filename) == 0);
+    }
+
+    stop_threads = false;
+    assert(pthread_barrier_init(&barrier, NULL, GET_READS_THREAD) == 0);
+    for (unsigned int each_thread = 0; each_thread < GET_READS_THREAD_SLAVE; each_thread++) {
+        assert(pthread_create(&thread_id[each_thread], NULL, get_reads_thread_fct, (void *)(uintptr_t)each_thread) == 0);
+    }
+
+    const size_t first_record_size[2] = { MAX_BUF_SIZE, MAX_BUF_SIZE };
+    input_files_fill(first_record_size);
+    for (unsigned int each_file = 0; each_file < 2; each_file++) {
+        input_file_t cursor = input_files[each_file];
+        record_size[each_file] = (cursor.data != NULL && skip_record_mmap(&cursor)) ? cursor.pos : MAX_BUF_SIZE;
+    }
+
+    if (input_files[0].data != NULL && input_files[0].window == NULL && input_files[1].data != NULL
+        && input_files[1].window == NULL) {
+        plan_passes();
+    }
+}
+
+void get_reads_rewind()
+{
+    if (input_files[0].data != NULL && input_files[1].data != NULL && parse_time > 0.0) {
+        printf("get_reads:\n"
+               "\tparsed: %lu MB in %lf s (%.2f GB/s)\n",
+            parsed_bytes >> 20, parse_time, (double)parsed_bytes / parse_time / 1e9);
+    }
+    parsed_bytes = 0ULL;
+    nb_parsed_pairs = 0;
+    parse_time = 0.0;
+    nb_dropped_passes = 0;
+    input_file_rewind(&input_files[0]);
+    input_file_rewind(&input_files[1]);
+
+    if (reads_cache != NULL) {
+        if (!reads_cache_complete) {
+            printf("\treads cache: %lu MB\n", ftell(reads_cache) >> 20);
+        }
+        rewind(reads_cache);
+        reads_cache_complete = true;
+    }
+    prefilter_print_stats();
+}
+
+void get_reads_free()
+{
+    stop_threads = true;
+    pthread_barrier_wait(&barrier);
+    assert(pthread_barrier_destroy(&barrier) == 0);
+    for (unsigned int each_thread = 0; each_thread < GET_READS_THREAD_SLAVE; each_thread++) {
+        assert(pthread_join(thread_id[each_thread], NULL) == 0);
+    }
+
+    input_file_free(&input_files[0]);
+    input_file_free(&input_files[1]);
+
+    if (reads_cache != NULL) {
+        fclose(reads_cache);
+        reads_cache = NULL;
+    }
+
+    for (unsigned int each_file = 0; each_file < 2; each_file++) {
+        free(pass_offsets[each_file]);
+        pass_offsets[each_file] = NULL;
+    }
+    nb_planned_passes = 0;
+}
+
+/**
+ * @brief Parse the pairs of the pass "input_pass_id" of the inputs into "reads_buffer".
+ *
+ * @return The number of reads parsed, 0 at the end of the inputs.
+ */
+static int parse_reads(uint8_t *reads_buffer, unsigned int input_pass_id)
+{
+    int nb_read = 0;
+    input_file_t *fpe1 = &input_files[0];
+    input_file_t *fpe2 = &input_files[1];
+    double start_time = my_clock();
+
+    if (fpe1->data != NULL && fpe2->data != NULL) {
+        nb_read = get_reads_parallel(reads_buffer, input_pass_id);
+    } else {
+        while (nb_read < MAX_READS_BUFFER) {
+            uint8_t *reads = &reads_buffer[nb_read * SIZE_READ_IN_BYTES];
+            bool read1 = get_seq(fpe1, &reads[0 * SIZE_READ_IN_BYTES], &reads[1 * SIZE_READ_IN_BYTES]) > 0;
+            bool read2 = get_seq(fpe2, &reads[2 * SIZE_READ_IN_BYTES], &reads[3 * SIZE_READ_IN_BYTES]) > 0;
+            if (read1 != read2) {
+                ERROR_EXIT(ERR_GETREAD_UNPAIRED_READS, "The PE%u reads end before the PE%u reads, after %lu pairs",
+                    read1 ? 2 : 1, read1 ? 1 : 2, nb_parsed_pairs + nb_read / 4);
+            }
+            if (!read1) {
+                break;
+            }
+            nb_read += 4;
+        }
+    }
+    nb_parsed_pairs += nb_read / 4;
+
+    parse_time += my_clock() - start_time;
+    return nb_read;
+}
+
+void get_reads(unsigned int pass_id)
 {
     int nb_read = 0;
-    pass_id = PASS(pass_id);
+    unsigned int buffer_id = PASS(pass_id);
 
-    int8_t *reads_buffer = reads_buffers[pass_id];
+    uint8_t *reads_buffer = reads_buffers[buffer_id];
     if (reads_buffer == NULL) {
-        reads_buffer = (int8_t *)malloc(MAX_READS_BUFFER * SIZE_READ);
+        reads_buffer = (uint8_t *)malloc(MAX_READS_BUFFER * SIZE_READ_IN_BYTES);
         assert(reads_buffer != NULL);
-        reads_buffers[pass_id] = reads_buffer;
+        reads_buffers[buffer_id] = reads_buffer;
+    }
+
+    if (reads_cache_complete) {
+        nb_reads[buffer_id] = reads_cache_read(reads_buffer);
+        return;
     }
 
-    while (nb_read < MAX_READS_BUFFER) {
-        if ((get_seq_fast_AQ(fpe1, &reads_buffer[(nb_read + 0) * SIZE_READ], &reads_buffer[(nb_read + 1) * SIZE_READ]) <= 0)
-            || (get_seq_fast_AQ(fpe2, &reads_buffer[(nb_read + 2) * SIZE_READ], &reads_buffer[(nb_read + 3) * SIZE_READ]) <= 0))
+    while ((nb_read = parse_reads(reads_buffer, pass_id + nb_dropped_passes)) != 0 && prefilter_enabled()) {
+        nb_read = prefilter_reads_buffer(reads_buffer, nb_read);
+        if (nb_read != 0) {
             break;
-        nb_read += 4;
+        }
+        nb_dropped_passes++;
     }
+    nb_reads[buffer_id] = nb_read;
 
-    nb_reads[pass_id] = nb_read;
+    if (reads_cache != NULL) {
+        reads_cache_write(reads_buffer, nb_read);
+    }
 }
 
 int get_reads_in_buffer(unsigned int pass_id) { return nb_reads[PASS(pass_id)]; }
 
-int8_t *get_reads_buffer(unsigned int pass_id) { return reads_buffers[PASS(pass_id)]; }
+uint8_t *get_reads_buffer(unsigned int pass_id) { return reads_buffers[PASS(pass_id)]; }
 
-int get_input_info(FILE *f, size_t *read_size, size_t *nb_read)
+int get_input_info(FILE *f, size_t *read_size)
 {
-    size_t size;
     char sequence_buffer[MAX_SEQ_SIZE];
+    bool error;
 
-    if (fgets(sequence_buffer, MAX_SEQ_SIZE, f) == NULL) { /* Commentary */
-        return -1;
+    if (is_gzip(f)) {
+        gzFile gz = open_gzip(f);
+        error = (gzgets(gz, sequence_buffer, MAX_SEQ_SIZE) == NULL) || (gzgets(gz, sequence_buffer, MAX_SEQ_SIZE) == NULL);
+        gzclose(gz);
+    } else {
+        error = (fgets(sequence_buffer, MAX_SEQ_SIZE, f) == NULL) /* Commentary */
+            || (fgets(sequence_buffer, MAX_SEQ_SIZE, f) == NULL); /* Sequence */
     }
-    if (fgets(sequence_buffer, MAX_SEQ_SIZE, f) == NULL) { /* Sequence */
+    rewind(f);
+    if (error) {
         return -1;
     }
-    size = strlen(sequence_buffer) - 1;
-
-    fseek(f, 0, SEEK_END);
-    size_t file_size = ftell(f);
-
-    *read_size = size;
-    *nb_read = file_size / (2 * size);
-
-    rewind(f);
+    *read_size = strlen(sequence_buffer) - 1;
     return 0;
 }
+
+unsigned int get_reads_nb_pass() { return nb_planned_passes; }
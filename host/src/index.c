@@ -4,7 +4,10 @@
 
 #define _GNU_SOURCE
 #include "index.h"
+#include "distribute.h"
+#include "encode.h"
 #include "genome.h"
+#include "getread.h"
 #include "mram_dpu.h"
 #include "parse_args.h"
 #include "upvc.h"
@@ -13,9 +16,12 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -23,47 +29,53 @@
 #include "common.h"
 
 #define CODE_SIZE (4)
-#define MASK (CODE_SIZE - 1)
 
-int code_seed(int8_t *sequence)
-{
-    int seed = 0;
-    for (int i = 0; i < SIZE_SEED; i++) {
-        if (sequence[i] >= CODE_SIZE) {
-            return -1;
-        }
-        seed = (seed * CODE_SIZE) + sequence[i];
-    }
-    return seed;
-}
-
-void code_neighbour(int8_t *sequence, int8_t *code)
+void index_copy_neighbour(int8_t *dst, uint8_t *read, unsigned int seed_position)
 {
+    /* The neighbour starts right after the seed, which is not necessarily on the first nucleotide of a byte */
+    const unsigned int neighbour_position = seed_position + SIZE_SEED;
+    const unsigned int shift = 2 * (neighbour_position % 4);
+    const uint8_t *src = &read[neighbour_position / 4];
     for (int i = 0; i < SIZE_NEIGHBOUR_IN_BYTES; i++) {
-        int j = i * 4;
-        code[i] = ((sequence[j + 3] & MASK) * (CODE_SIZE * CODE_SIZE * CODE_SIZE))
-            + ((sequence[j + 2] & MASK) * (CODE_SIZE * CODE_SIZE)) + ((sequence[j + 1] & MASK) * (CODE_SIZE))
-            + ((sequence[j] & MASK));
+        dst[i] = (src[i] >> shift) | (src[i + 1] << (8 - shift));
     }
 }
 
-void index_copy_neighbour(int8_t *dst, int8_t *src) { code_neighbour(&src[SIZE_SEED], dst); }
-
 #define NB_SEED (1 << (SIZE_SEED << 1)) /* NB_SEED = 4 ^ (SIZE_SEED) */
 
 #define MAX_SIZE_IDX_SEED (500)
 
+/**
+ * @brief The seeds looked up for a read are at positions 0, SEED_POSITION_STEP, ..., (NB_SEED_POSITIONS - 1) *
+ * SEED_POSITION_STEP: the neighbours compared are at most 3 bytes shorter.
+ */
+#define NB_SEED_POSITIONS (4)
+#define SEED_POSITION_STEP (4)
+_Static_assert(MAX_SIZE_IDX_SEED < (1 << 12), "index_seed_t cannot hold the number of neighbours of a chunk");
+_Static_assert(MAX_CHUNK_COPIES <= (1 << 4), "index_seed_t cannot hold the number of copies of a chunk");
+
 typedef struct hashtable_header {
     uint32_t magic;
     uint32_t version;
     uint32_t size_read;
     uint32_t size_seed;
     uint32_t nb_dpus;
-    uint32_t unused;
-    uint64_t nb_seed_total;
+    uint32_t max_seed_occurrences;
+    uint64_t nb_chunks;
+    uint32_t nb_capped_seeds;
+    uint32_t max_chunk_copies;
+    uint64_t nb_chunk_copies;
 } hashtable_header_t;
 
-#define INDEX_VERSION 1
+/*
+ * index.bin is made of the header, the directory of the seeds (NB_SEED + 1 uint32_t, see index_seed_start) and the
+ * chunks of all the seeds (nb_chunks index_seed_t).
+ * The seeds occurring more than max_seed_occurrences times (if not 0) have no chunk, like the seeds absent from the reference
+ * genome: the reads are dispatched on another of their seeds (see index_get).
+ * The chunks the most compared are followed by their copies (nb_chunk_copies in total, see index_seed_t).
+ * Their neighbours are in mrams.pack, with the MRAM images of all the DPUs (see mram_dpu.c).
+ */
+#define INDEX_VERSION 6
 static hashtable_header_t hashtable_header
     = { .magic = 0x1dec, .version = INDEX_VERSION, .size_read = SIZE_READ, .size_seed = SIZE_SEED };
 
@@ -79,15 +91,62 @@ static char *get_index_filename()
 static unsigned int nb_indexed_dpu;
 unsigned int index_get_nb_dpu() { return nb_indexed_dpu; }
 
+/**
+ * @brief Directory of the seeds: the chunks of the seed "seed_code" are index_seed[index_seed_start[seed_code]] to
+ * index_seed[index_seed_start[seed_code + 1] - 1].
+ */
+static uint32_t *index_seed_start;
 static index_seed_t *index_seed;
+/**
+ * @brief Mapping of index.bin when the index has been loaded, NULL when it has been created.
+ */
+static void *index_mapping;
+static size_t index_mapping_size;
 
-index_seed_t *index_get(int8_t *read)
+static index_seed_t *get_seed_chunks(int seed_code, unsigned int *nb_chunks)
 {
-    index_seed_t *seed = &index_seed[code_seed(read)];
-    if (seed->nb_nbr == 0 && seed->next == NULL)
-        return NULL;
-    else
-        return seed;
+    uint32_t first_chunk = index_seed_start[seed_code];
+    *nb_chunks = index_seed_start[seed_code + 1] - first_chunk;
+    return &index_seed[first_chunk];
+}
+
+/**
+ * @brief Count the neighbours of the chunks of a seed, stopping as soon as there are more than "max_nb_neighbour".
+ */
+static uint64_t count_neighbours(index_seed_t *seed, unsigned int nb_chunks, uint64_t max_nb_neighbour)
+{
+    uint64_t nb_neighbour = 0;
+    for (unsigned int each_chunk = 0; each_chunk < nb_chunks && nb_neighbour <= max_nb_neighbour;
+         each_chunk += 1 + seed[each_chunk].nb_replicas) {
+        nb_neighbour += seed[each_chunk].nb_nbr;
+    }
+    return nb_neighbour;
+}
+
+index_seed_t *index_get(uint8_t *read, unsigned int *seed_position, unsigned int *nb_chunks)
+{
+    index_seed_t *best_seed = NULL;
+    uint64_t best_nb_neighbour = UINT64_MAX;
+    *seed_position = 0;
+    *nb_chunks = 0;
+
+    for (unsigned int position = 0; position < NB_SEED_POSITIONS * SEED_POSITION_STEP; position += SEED_POSITION_STEP) {
+        int seed_code = 0;
+        for (int i = 0; i < SIZE_SEED; i++) {
+            seed_code = (seed_code * CODE_SIZE) + read_get_nucleotide(read, position + i);
+        }
+        unsigned int nb_chunks_at_position;
+        index_seed_t *seed = get_seed_chunks(seed_code, &nb_chunks_at_position);
+        uint64_t nb_neighbour = count_neighbours(seed, nb_chunks_at_position, best_nb_neighbour);
+        /* A seed absent from the reference genome (e.g. because of a sequencing error) cannot map the read */
+        if (nb_neighbour != 0 && nb_neighbour < best_nb_neighbour) {
+            best_seed = seed;
+            best_nb_neighbour = nb_neighbour;
+            *seed_position = position;
+            *nb_chunks = nb_chunks_at_position;
+        }
+    }
+    return best_seed;
 }
 
 typedef struct seed_counter {
@@ -95,26 +154,36 @@ typedef struct seed_counter {
     int seed_code;
 } seed_counter_t;
 
-static int cmp_seed_counter(void const *a, void const *b)
+unsigned int index_get_size_read()
 {
-    seed_counter_t *seed_counter_a = (seed_counter_t *)a;
-    seed_counter_t *seed_counter_b = (seed_counter_t *)b;
-    if (seed_counter_a->nb_seed < seed_counter_b->nb_seed) {
-        return 1;
-    } else {
-        return -1;
+    hashtable_header_t header;
+    FILE *f = fopen(get_index_filename(), "r");
+    if (f == NULL) {
+        return 0;
     }
+    size_t nb_header = fread(&header, sizeof(header), 1, f);
+    fclose(f);
+    return (nb_header == 1 && header.magic == hashtable_header.magic) ? header.size_read : 0;
 }
 
 void index_load()
 {
     double start_time = my_clock();
     printf("%s:\n", __func__);
-    FILE *f = fopen(get_index_filename(), "r");
-    CHECK_FILE(f, get_index_filename());
+    int fd = open(get_index_filename(), O_RDONLY);
+    if (fd == -1) {
+        ERROR_EXIT(ERR_FOPEN_FAILED, "Could not open file '%s' (%s)", get_index_filename(), strerror(errno));
+    }
+    struct stat index_stat;
+    assert(fstat(fd, &index_stat) == 0);
+    assert((size_t)index_stat.st_size >= sizeof(hashtable_header_t) && "Truncated index");
 
-    hashtable_header_t header;
-    xfer_file((uint8_t *)&header, sizeof(header), f, xfer_read);
+    index_mapping_size = index_stat.st_size;
+    index_mapping = mmap(NULL, index_mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+    assert(index_mapping != MAP_FAILED);
+    close(fd);
+
+    hashtable_header_t header = *(hashtable_header_t *)index_mapping;
     assert(header.magic == hashtable_header.magic
         && "Wrong header, make sure you have generated your MRAMs with the same version of UPVC that you are "
            "using.");
@@ -122,26 +191,26 @@ void index_load()
     assert(header.size_read == hashtable_header.size_read && "Could not load an index generated with a different size of read.");
     assert(header.size_seed == hashtable_header.size_seed && "Could not load an index generated with a different size of seed.");
 
-    index_seed = (index_seed_t *)malloc(header.nb_seed_total * sizeof(index_seed_t));
-    assert(index_seed != NULL);
-
-    xfer_file((uint8_t *)index_seed, sizeof(index_seed_t) * header.nb_seed_total, f, xfer_read);
+    const size_t directory_size = (NB_SEED + 1) * sizeof(uint32_t);
+    assert(index_mapping_size == sizeof(header) + directory_size + header.nb_chunks * sizeof(index_seed_t) && "Truncated index");
 
-    for (unsigned int each_seed = 0; each_seed < header.nb_seed_total; each_seed++) {
-        if ((uintptr_t)index_seed[each_seed].next == UINTPTR_MAX) {
-            index_seed[each_seed].next = NULL;
-        } else {
-            index_seed[each_seed].next = (struct index_seed *)((uintptr_t)index_seed[each_seed].next + (uintptr_t)index_seed);
-        }
-    }
+    /* The seeds are looked up in a random order: no need to read ahead */
+    madvise(index_mapping, index_mapping_size, MADV_RANDOM);
+    index_seed_start = (uint32_t *)((uint8_t *)index_mapping + sizeof(header));
+    index_seed = (index_seed_t *)((uint8_t *)index_seed_start + directory_size);
 
     nb_indexed_dpu = header.nb_dpus;
     printf("\tnb_dpu: %u\n"
            "\tsize_read: %u\n"
            "\tsize_seed: %u\n",
         nb_indexed_dpu, header.size_read, header.size_seed);
+    if (header.max_seed_occurrences != 0) {
+        printf("\tcapped seeds: %u (more than %u occurrences)\n", header.nb_capped_seeds, header.max_seed_occurrences);
+    }
+    if (header.nb_chunk_copies != 0) {
+        printf("\tchunk copies: %lu (up to %u DPUs per chunk)\n", header.nb_chunk_copies, header.max_chunk_copies);
+    }
 
-    fclose(f);
     printf("\ttime: %lf s\n", my_clock() - start_time);
 }
 
@@ -151,7 +220,161 @@ static int compute_nb_index_needed(int nb_seed) { return (nb_seed + MAX_SIZE_IDX
 #define INDEX_THREAD_SLAVE (INDEX_THREAD - 1)
 static seed_counter_t *seed_counter;
 static pthread_barrier_t barrier;
-static uint64_t nb_seed_total;
+static uint64_t nb_chunks_total;
+static unsigned int max_seed_occurrences;
+static unsigned int nb_capped_seeds;
+static unsigned int max_chunk_copies;
+static uint64_t nb_chunk_copies;
+/**
+ * @brief A chunk gets a copy for each hot_chunk_workload of its workload (see compute_nb_copies).
+ */
+static uint64_t hot_chunk_workload;
+/**
+ * @brief A chunk is copied on another DPU for each HOT_CHUNK_PERCENT % of the mean workload of a DPU it accounts for.
+ */
+#define HOT_CHUNK_PERCENT (1)
+
+static bool is_capped(int nb_seed) { return max_seed_occurrences != 0 && (unsigned int)nb_seed > max_seed_occurrences; }
+
+static unsigned int compute_nb_copies(unsigned int nb_nbr, unsigned int nb_seed)
+{
+    uint64_t nb_copies = ((uint64_t)nb_nbr * (uint64_t)nb_seed) / hot_chunk_workload;
+    return nb_copies < 1 ? 1 : nb_copies > max_chunk_copies ? max_chunk_copies : nb_copies;
+}
+
+/**
+ * @brief Number of chunks needed by a seed occurring "nb_seed" times, copies included.
+ */
+static unsigned int compute_nb_chunks_and_copies(int nb_seed)
+{
+    unsigned int nb_index_needed = compute_nb_index_needed(nb_seed);
+    if (nb_index_needed == 0) {
+        return 0;
+    }
+    unsigned int nb_neighbour_per_index = (nb_seed + nb_index_needed - 1) / nb_index_needed;
+    unsigned int nb_neighbour_first_index = nb_seed - (nb_index_needed - 1) * nb_neighbour_per_index;
+    return compute_nb_copies(nb_neighbour_first_index, nb_seed)
+        + (nb_index_needed - 1) * compute_nb_copies(nb_neighbour_per_index, nb_seed);
+}
+
+/**
+ * @brief The genome is scanned by blocks of SCAN_BLOCK_SIZE positions, each thread taking a contiguous slice of the block.
+ * A thread sorts the seeds of its slice by the thread owning them, with a local histogram whose prefix sums give where the
+ * seeds of each owner go. Then each thread processes the seeds it owns, from all the slices in the order of the genome: a
+ * seed is only ever handled by its owner, without atomic operation nor cache line shared with another thread.
+ */
+#define SCAN_BLOCK_SIZE (1 << 22)
+#define SCAN_SLICE_SIZE (SCAN_BLOCK_SIZE / INDEX_THREAD)
+/* 16 consecutive seeds per owner, to share neither the cache lines of seed_counter nor the ones of index_seed_start */
+#define SEED_OWNER(seed_code) ((((unsigned int)(seed_code)) >> 4) % INDEX_THREAD)
+
+typedef struct {
+    uint32_t seed_code;
+    uint32_t seq_nr;
+    uint32_t seed_nr;
+} seed_occurrence_t;
+
+typedef void (*process_seed_fct_t)(genome_t *ref_genome, seed_occurrence_t *seed_occurrence);
+/**
+ * @brief Called by a single thread at the end of each block, while the other ones only encode the next block.
+ */
+typedef void (*end_of_block_fct_t)();
+
+static seed_occurrence_t *slice_seeds[INDEX_THREAD];
+static uint32_t slice_owner_start[INDEX_THREAD][INDEX_THREAD + 1];
+
+static void print_scan_progress(genome_t *ref_genome, uint32_t seq_number, uint64_t nb_positions_done, double start_time)
+{
+    double time = my_clock() - start_time;
+    char time_str[FILENAME_MAX];
+    if (time < 60.0) {
+        sprintf(time_str, " - %us ", (unsigned int)time);
+    } else if (time < 3600.0) {
+        sprintf(time_str, " - %umin%us ", (unsigned int)time / 60, (unsigned int)time % 60);
+    } else {
+        sprintf(time_str, " - %uh%umin%us ", (unsigned int)time / 3600, (unsigned int)(time / 60) % 60, (unsigned int)time % 60);
+    }
+    if (seq_number == ref_genome->nb_seq) {
+        printf("\r\t\t100.00%%#%u%s\n", ref_genome->nb_seq, time_str);
+        return;
+    }
+    printf("\r\t\t%2.2f%%#%u%s", ((float)nb_positions_done) * 100.0 / ref_genome->len_seq[seq_number], seq_number, time_str);
+    fflush(stdout);
+}
+
+static void scan_genome(int thread_id, process_seed_fct_t process_seed, end_of_block_fct_t end_of_block)
+{
+    genome_t *ref_genome = genome_get();
+    int32_t *slice_codes = (int32_t *)malloc(SCAN_SLICE_SIZE * sizeof(int32_t));
+    assert(slice_codes != NULL);
+    slice_seeds[thread_id] = (seed_occurrence_t *)malloc(SCAN_SLICE_SIZE * sizeof(seed_occurrence_t));
+    assert(slice_seeds[thread_id] != NULL);
+    double start_time = my_clock(), last_progress_time = start_time;
+
+    for (uint32_t seq_number = 0; seq_number < ref_genome->nb_seq; seq_number++) {
+        uint64_t sequence_start_idx = ref_genome->pt_seq[seq_number];
+        uint64_t nb_positions = ref_genome->len_seq[seq_number] > SIZE_NEIGHBOUR_IN_BYTES + SIZE_SEED - 1
+            ? ref_genome->len_seq[seq_number] - SIZE_NEIGHBOUR_IN_BYTES - SIZE_SEED + 1
+            : 0;
+        for (uint64_t block_start = 0; block_start < nb_positions; block_start += SCAN_BLOCK_SIZE) {
+            uint64_t slice_start = block_start + (uint64_t)thread_id * SCAN_SLICE_SIZE;
+            uint64_t slice_end = slice_start + SCAN_SLICE_SIZE;
+            slice_start = slice_start < nb_positions ? slice_start : nb_positions;
+            slice_end = slice_end < nb_positions ? slice_end : nb_positions;
+
+            uint32_t owner_next[INDEX_THREAD] = { 0 };
+            encode_seeds(&ref_genome->data[sequence_start_idx + slice_start], slice_end - slice_start, slice_codes);
+            for (uint64_t sequence_idx = slice_start; sequence_idx < slice_end; sequence_idx++) {
+                int seed_code = slice_codes[sequence_idx - slice_start];
+                if (seed_code >= 0) {
+                    owner_next[SEED_OWNER(seed_code)]++;
+                }
+            }
+            uint32_t *owner_start = slice_owner_start[thread_id];
+            owner_start[0] = 0;
+            for (unsigned int each_owner = 0; each_owner < INDEX_THREAD; each_owner++) {
+                owner_start[each_owner + 1] = owner_start[each_owner] + owner_next[each_owner];
+                owner_next[each_owner] = owner_start[each_owner];
+            }
+            for (uint64_t sequence_idx = slice_start; sequence_idx < slice_end; sequence_idx++) {
+                int seed_code = slice_codes[sequence_idx - slice_start];
+                if (seed_code >= 0) {
+                    slice_seeds[thread_id][owner_next[SEED_OWNER(seed_code)]++]
+                        = (seed_occurrence_t) { .seed_code = seed_code, .seq_nr = seq_number, .seed_nr = sequence_idx };
+                }
+            }
+            pthread_barrier_wait(&barrier);
+
+            for (unsigned int each_slice = 0; each_slice < INDEX_THREAD; each_slice++) {
+                seed_occurrence_t *seeds = slice_seeds[each_slice];
+                for (uint32_t each_seed = slice_owner_start[each_slice][thread_id];
+                     each_seed < slice_owner_start[each_slice][thread_id + 1]; each_seed++) {
+                    process_seed(ref_genome, &seeds[each_seed]);
+                }
+            }
+            pthread_barrier_wait(&barrier);
+
+            if (thread_id == INDEX_THREAD_SLAVE && end_of_block != NULL) {
+                end_of_block();
+            }
+            if (thread_id == INDEX_THREAD_SLAVE && my_clock() - last_progress_time >= 1.0) {
+                last_progress_time = my_clock();
+                print_scan_progress(ref_genome, seq_number, slice_end, start_time);
+            }
+        }
+    }
+    if (thread_id == INDEX_THREAD_SLAVE) {
+        print_scan_progress(ref_genome, ref_genome->nb_seq, 0, start_time);
+    }
+
+    free(slice_seeds[thread_id]);
+    free(slice_codes);
+}
+
+static void count_seed(__attribute__((unused)) genome_t *ref_genome, seed_occurrence_t *seed_occurrence)
+{
+    seed_counter[seed_occurrence->seed_code].nb_seed++;
+}
 
 static void set_seed_counter(int thread_id)
 {
@@ -160,139 +383,139 @@ static void set_seed_counter(int thread_id)
         seed_counter[i].nb_seed = 0;
         seed_counter[i].seed_code = i;
     }
-
-    static genome_t *ref_genome;
-    if (thread_id == 0)
-        ref_genome = genome_get();
     pthread_barrier_wait(&barrier);
 
-    for (uint32_t i = 0; i < ref_genome->nb_seq; i++) {
-        uint64_t sequence_start_idx = ref_genome->pt_seq[i];
-        for (uint64_t sequence_idx = thread_id; sequence_idx < ref_genome->len_seq[i] - SIZE_NEIGHBOUR_IN_BYTES - SIZE_SEED + 1;
-             sequence_idx += INDEX_THREAD) {
-            int seed_code = code_seed(&ref_genome->data[sequence_start_idx + sequence_idx]);
-            if (seed_code >= 0) {
-                __sync_fetch_and_add(&seed_counter[seed_code].nb_seed, 1);
-            }
-        }
-    }
-    pthread_barrier_wait(&barrier);
+    scan_genome(thread_id, count_seed, NULL);
 }
 
 static void init_index_seed(int thread_id)
 {
-    static uint64_t seed_offset = NB_SEED;
-
     pthread_barrier_wait(&barrier);
     for (int i = thread_id; i < NB_SEED; i += INDEX_THREAD) {
-        if (seed_counter[i].nb_seed == 0) {
-            index_seed[i].nb_nbr = 0;
-            index_seed[i].next = NULL;
+        unsigned int nb_chunks;
+        index_seed_t *seed = get_seed_chunks(i, &nb_chunks);
+        if (nb_chunks == 0) {
             continue;
         }
 
         int nb_index_needed = compute_nb_index_needed(seed_counter[i].nb_seed);
         int nb_neighbour_per_index = (seed_counter[i].nb_seed + nb_index_needed - 1) / nb_index_needed;
-        index_seed[i].nb_nbr = seed_counter[i].nb_seed - ((nb_index_needed - 1) * nb_neighbour_per_index);
-        index_seed[i].next = NULL;
-        for (int j = 1; j < nb_index_needed; j++) {
-            index_seed_t *seed = &index_seed[__sync_fetch_and_add(&seed_offset, 1)];
-            seed->nb_nbr = nb_neighbour_per_index;
-            seed->next = index_seed[i].next;
-            index_seed[i].next = seed;
+        for (int j = 0; j < nb_index_needed; j++) {
+            unsigned int nb_nbr
+                = (j == 0) ? seed_counter[i].nb_seed - ((nb_index_needed - 1) * nb_neighbour_per_index) : nb_neighbour_per_index;
+            unsigned int nb_copies = compute_nb_copies(nb_nbr, seed_counter[i].nb_seed);
+            for (unsigned int each_copy = 0; each_copy < nb_copies; each_copy++, seed++) {
+                seed->nb_nbr = nb_nbr;
+                seed->nb_replicas = (each_copy == 0) ? nb_copies - 1 : 0;
+            }
         }
     }
     pthread_barrier_wait(&barrier);
 }
 
-static void adjust_index_seed_next(int thread_id)
+/**
+ * @brief The seeds with chunks are sorted by decreasing number of occurrences, then by increasing seed code, with a
+ * parallel LSD radix sort of RADIX_BITS bits per pass. Each thread counts the digits of a contiguous part of the seeds in
+ * its own histogram, then moves its seeds where the prefix sums of all the histograms, digit after digit, tell.
+ */
+#define RADIX_BITS (11)
+#define RADIX_SIZE (1 << RADIX_BITS)
+static uint32_t radix_histograms[INDEX_THREAD][RADIX_SIZE];
+static seed_counter_t *sorted_seeds;
+static seed_counter_t *sort_buffer;
+static uint32_t nb_sorted_seeds;
+static uint32_t max_sorted_nb_seed;
+
+static bool has_chunks(int seed_code) { return index_seed_start[seed_code + 1] != index_seed_start[seed_code]; }
+
+static unsigned int radix_digit(seed_counter_t *seed, unsigned int shift)
 {
-    pthread_barrier_wait(&barrier);
-    for (unsigned int i = thread_id; i < nb_seed_total; i += INDEX_THREAD) {
-        if (index_seed[i].next == NULL) {
-            index_seed[i].next = (index_seed_t *)(UINTPTR_MAX);
-        } else {
-            index_seed[i].next = (index_seed_t *)((uintptr_t)index_seed[i].next - (uintptr_t)index_seed);
-        }
-    }
-    pthread_barrier_wait(&barrier);
+    /* The digits of the complement give the decreasing order */
+    return ((max_sorted_nb_seed - (uint32_t)seed->nb_seed) >> shift) & (RADIX_SIZE - 1);
 }
-static void write_data(int thread_id)
+
+static void sort_seed_counter(int thread_id)
 {
-    static genome_t *ref_genome;
-    static volatile uint32_t seq_number_shared[INDEX_THREAD_SLAVE] = { 0 };
-    static volatile uint64_t sequence_idx_shared[INDEX_THREAD_SLAVE] = { 0 };
-    coords_and_nbr_t buffer;
-    if (thread_id == 0)
-        ref_genome = genome_get();
     pthread_barrier_wait(&barrier);
-    if (thread_id == INDEX_THREAD_SLAVE) {
-        double start_time = my_clock();
-        while (true) {
-            uint32_t slowest_thread_seq = UINT_MAX;
-            uint64_t slowest_thread_sequence = ULONG_MAX;
-            for (unsigned int each_thread = 0; each_thread < INDEX_THREAD_SLAVE; each_thread++) {
-                uint32_t curr_seq = seq_number_shared[each_thread];
-                uint32_t sequence_curr = sequence_idx_shared[each_thread];
-                if (curr_seq < slowest_thread_seq) {
-                    slowest_thread_seq = curr_seq;
-                    slowest_thread_sequence = sequence_curr;
-                } else if (curr_seq == slowest_thread_seq && sequence_curr < slowest_thread_sequence) {
-                    slowest_thread_sequence = sequence_curr;
-                }
+    /* The first pass only moves the seeds with chunks (neither absent from the genome nor capped) out of seed_counter */
+    seed_counter_t *src = seed_counter;
+    seed_counter_t *dst = sort_buffer;
+    uint64_t nb_src = NB_SEED;
+    bool first_pass = true;
+    unsigned int shift = 0;
+    do {
+        uint32_t *histogram = radix_histograms[thread_id];
+        uint64_t begin = nb_src * thread_id / INDEX_THREAD;
+        uint64_t end = nb_src * (thread_id + 1) / INDEX_THREAD;
+
+        memset(histogram, 0, sizeof(radix_histograms[thread_id]));
+        for (uint64_t i = begin; i < end; i++) {
+            if (!first_pass || has_chunks(i)) {
+                histogram[radix_digit(&src[i], shift)]++;
             }
-            double time = my_clock() - start_time;
-            char time_str[FILENAME_MAX];
-            if (time < 60.0) {
-                sprintf(time_str, " - %us ", (unsigned int)time);
-            } else if (time < 3600.0) {
-                sprintf(time_str, " - %umin%us ", (unsigned int)time / 60, (unsigned int)time % 60);
-            } else {
-                sprintf(time_str, " - %uh%umin%us ", (unsigned int)time / 3600, (unsigned int)(time / 60) % 60,
-                    (unsigned int)time % 60);
+        }
+        pthread_barrier_wait(&barrier);
+
+        uint32_t position[RADIX_SIZE];
+        uint32_t nb_seeds_before = 0;
+        for (unsigned int digit = 0; digit < RADIX_SIZE; digit++) {
+            for (int each_thread = 0; each_thread < INDEX_THREAD; each_thread++) {
+                if (each_thread == thread_id) {
+                    position[digit] = nb_seeds_before;
+                }
+                nb_seeds_before += radix_histograms[each_thread][digit];
             }
-            if (slowest_thread_seq == ref_genome->nb_seq) {
-                printf("\r\t\t100.00%%#%u%s\n", ref_genome->nb_seq, time_str);
-                break;
+        }
+        for (uint64_t i = begin; i < end; i++) {
+            if (!first_pass || has_chunks(i)) {
+                dst[position[radix_digit(&src[i], shift)]++] = src[i];
             }
-            printf("\r\t\t%2.2f%%#%u%s", ((float)slowest_thread_sequence) * 100.0 / ref_genome->len_seq[slowest_thread_seq],
-                slowest_thread_seq, time_str);
-            fflush(stdout);
-            usleep(1000000);
         }
-    } else {
-        for (uint32_t seq_number = 0; seq_number < ref_genome->nb_seq; seq_number++, seq_number_shared[thread_id] = seq_number) {
-            uint64_t sequence_start_idx = ref_genome->pt_seq[seq_number];
-            for (uint64_t sequence_idx = thread_id;
-                 sequence_idx < ref_genome->len_seq[seq_number] - SIZE_NEIGHBOUR_IN_BYTES - SIZE_SEED + 1;
-                 sequence_idx += INDEX_THREAD_SLAVE, sequence_idx_shared[thread_id] = sequence_idx) {
-                index_seed_t *seed;
-                int align_idx;
-                int seed_code = code_seed(&ref_genome->data[sequence_start_idx + sequence_idx]);
-
-                if (seed_code < 0) {
-                    continue;
-                }
+        pthread_barrier_wait(&barrier);
 
-                seed = &index_seed[seed_code];
+        src = dst;
+        dst = (src == sort_buffer) ? seed_counter : sort_buffer;
+        nb_src = nb_sorted_seeds;
+        first_pass = false;
+        shift += RADIX_BITS;
+    } while (shift < 32 && (max_sorted_nb_seed >> shift) != 0);
 
-                int total_nb_neighbour = 0;
-                int32_t nb_seed = __sync_fetch_and_add(&seed_counter[seed_code].nb_seed, 1);
-                while (seed != NULL) {
-                    if (nb_seed < (int)seed->nb_nbr + total_nb_neighbour)
-                        break;
-                    total_nb_neighbour += seed->nb_nbr;
-                    seed = seed->next;
-                }
-                align_idx = seed->offset + nb_seed - total_nb_neighbour;
+    if (thread_id == INDEX_THREAD_SLAVE) {
+        sorted_seeds = src;
+    }
+}
 
-                buffer.coord.seq_nr = seq_number;
-                buffer.coord.seed_nr = sequence_idx;
-                code_neighbour(&ref_genome->data[sequence_start_idx + sequence_idx + SIZE_SEED], (int8_t *)&buffer.nbr);
-                write_vmi(seed->num_dpu, align_idx, &buffer);
-            }
-        }
+static void write_seed(genome_t *ref_genome, seed_occurrence_t *seed_occurrence)
+{
+    coords_and_nbr_t buffer = { 0 };
+    unsigned int nb_chunks;
+    index_seed_t *seed = get_seed_chunks(seed_occurrence->seed_code, &nb_chunks);
+    if (nb_chunks == 0) {
+        /* Capped seed */
+        return;
+    }
+
+    int total_nb_neighbour = 0;
+    int32_t nb_seed = seed_counter[seed_occurrence->seed_code].nb_seed++;
+    while (nb_seed >= (int)seed->nb_nbr + total_nb_neighbour) {
+        total_nb_neighbour += seed->nb_nbr;
+        seed += 1 + seed->nb_replicas;
     }
+
+    buffer.coord.seq_nr = seed_occurrence->seq_nr;
+    buffer.coord.seed_nr = seed_occurrence->seed_nr;
+    uint64_t sequence_idx = ref_genome->pt_seq[seed_occurrence->seq_nr] + seed_occurrence->seed_nr;
+    encode_neighbour(&ref_genome->data[sequence_idx + SIZE_SEED], buffer.nbr);
+    for (index_seed_t *last_copy = &seed[seed->nb_replicas]; seed <= last_copy; seed++) {
+        int align_idx = seed->offset + nb_seed - total_nb_neighbour;
+        write_vmi(seed->num_dpu, align_idx, &buffer);
+    }
+}
+
+static void write_data(int thread_id)
+{
+    pthread_barrier_wait(&barrier);
+    scan_genome(thread_id, write_seed, flush_vmis);
     pthread_barrier_wait(&barrier);
 }
 
@@ -302,8 +525,8 @@ static void *index_create_slave_fct(void *args)
 
     set_seed_counter(thread_id);
     init_index_seed(thread_id);
+    sort_seed_counter(thread_id);
     write_data(thread_id);
-    adjust_index_seed_next(thread_id);
 
     return NULL;
 }
@@ -321,11 +544,46 @@ void index_create_folder()
     free(index_folder);
 }
 
+/**
+ * @brief Give the chunk "seed" and its copies to as many DPUs, sharing its "workload" between them.
+ */
+static void distribute_chunk_and_copies(index_seed_t *seed, uint64_t workload)
+{
+    if (seed->nb_replicas == 0) {
+        seed->num_dpu = distribute_chunk(seed->nb_nbr, workload, &seed->offset)->dpu_id;
+        return;
+    }
+
+    unsigned int nb_copies = 1 + seed->nb_replicas;
+    distribute_index_t *dpus[MAX_CHUNK_COPIES];
+    uint32_t offsets[MAX_CHUNK_COPIES];
+    distribute_chunk_copies(seed->nb_nbr, workload / nb_copies, nb_copies, dpus, offsets);
+    for (unsigned int each_copy = 0; each_copy < nb_copies; each_copy++) {
+        seed[each_copy].num_dpu = dpus[each_copy]->dpu_id;
+        seed[each_copy].offset = offsets[each_copy];
+    }
+}
+
+static void write_index(const char *filename, hashtable_header_t *header, index_seed_t *chunks)
+{
+    FILE *f = fopen(filename, "w");
+    CHECK_FILE(f, filename);
+
+    fwrite(header, sizeof(hashtable_header_t), 1, f);
+    xfer_file((uint8_t *)index_seed_start, sizeof(uint32_t) * (NB_SEED + 1), f, xfer_write);
+    xfer_file((uint8_t *)chunks, sizeof(index_seed_t) * header->nb_chunks, f, xfer_write);
+
+    fclose(f);
+}
+
 void index_create()
 {
     unsigned int nb_dpu = get_nb_dpu();
+    max_seed_occurrences = get_max_seed_occurrences();
+    max_chunk_copies = get_max_chunk_copies() < nb_dpu ? get_max_chunk_copies() : nb_dpu;
     double start_time = my_clock();
     printf("%s(%i):\n", __func__, nb_dpu);
+    assert(nb_dpu <= UINT16_MAX && "Too many DPUs to be numbered in the index");
     pthread_t thread_id[INDEX_THREAD_SLAVE];
     distribute_index_t *distribute_index_table;
 
@@ -346,20 +604,52 @@ void index_create()
     {
         double alloc_index_seed_time = my_clock();
         printf("\tAllocating the index table\n");
-        nb_seed_total = NB_SEED;
+        index_seed_start = (uint32_t *)malloc((NB_SEED + 1) * sizeof(uint32_t));
+        assert(index_seed_start != NULL);
+        nb_chunks_total = 0;
+        nb_capped_seeds = 0;
+        uint64_t nb_capped_neighbours = 0;
+        uint64_t total_workload = 0;
         for (int i = 0; i < NB_SEED; i++) {
-            nb_seed_total += compute_nb_index_needed(seed_counter[i].nb_seed);
+            if (is_capped(seed_counter[i].nb_seed)) {
+                nb_capped_seeds++;
+                nb_capped_neighbours += seed_counter[i].nb_seed;
+            } else {
+                total_workload += (uint64_t)seed_counter[i].nb_seed * (uint64_t)seed_counter[i].nb_seed;
+            }
         }
-        index_seed = (index_seed_t *)malloc(sizeof(index_seed_t) * nb_seed_total);
+        hot_chunk_workload = total_workload * HOT_CHUNK_PERCENT / 100 / nb_dpu;
+        hot_chunk_workload = hot_chunk_workload != 0 ? hot_chunk_workload : 1;
+
+        uint64_t nb_chunks_without_copies = 0;
+        nb_sorted_seeds = 0;
+        max_sorted_nb_seed = 0;
+        for (int i = 0; i < NB_SEED; i++) {
+            index_seed_start[i] = nb_chunks_total;
+            if (seed_counter[i].nb_seed == 0 || is_capped(seed_counter[i].nb_seed)) {
+                continue;
+            }
+            nb_sorted_seeds++;
+            if ((uint32_t)seed_counter[i].nb_seed > max_sorted_nb_seed) {
+                max_sorted_nb_seed = seed_counter[i].nb_seed;
+            }
+            nb_chunks_without_copies += compute_nb_index_needed(seed_counter[i].nb_seed);
+            nb_chunks_total += compute_nb_chunks_and_copies(seed_counter[i].nb_seed);
+            assert(nb_chunks_total <= UINT32_MAX && "Too many chunks to be addressed by the directory of the seeds");
+        }
+        index_seed_start[NB_SEED] = nb_chunks_total;
+        nb_chunk_copies = nb_chunks_total - nb_chunks_without_copies;
+        index_seed = (index_seed_t *)malloc(sizeof(index_seed_t) * nb_chunks_total);
         assert(index_seed != NULL);
-        printf("\t\tnb_seed_total=%lu\n"
+        printf("\t\tnb_chunks_total=%lu (%lu copies)\n"
+               "\t\tnb_capped_seeds=%u (%lu neighbours kept out of the DPUs)\n"
                "\t\ttime: %lf s\n",
-            nb_seed_total, my_clock() - alloc_index_seed_time);
+            nb_chunks_total, nb_chunk_copies, nb_capped_seeds, nb_capped_neighbours, my_clock() - alloc_index_seed_time);
     }
 
     {
         double create_init_link_all_seed_time = my_clock();
-        printf("\tCreate, initialize and link together all the seeds\n");
+        printf("\tCreate and initialize the chunks of all the seeds\n");
         init_index_seed(INDEX_THREAD_SLAVE);
         printf("\t\ttime: %lf s\n", my_clock() - create_init_link_all_seed_time);
     }
@@ -367,7 +657,10 @@ void index_create()
     {
         double sort_time = my_clock();
         printf("\tSort seed counter\n");
-        qsort(seed_counter, NB_SEED, sizeof(seed_counter_t), cmp_seed_counter);
+        sort_buffer = (seed_counter_t *)malloc((nb_sorted_seeds + 1) * sizeof(seed_counter_t));
+        assert(sort_buffer != NULL);
+        sort_seed_counter(INDEX_THREAD_SLAVE);
+        printf("\t\tnb_sorted_seeds=%u\n", nb_sorted_seeds);
         printf("\t\ttime: %lf s\n", my_clock() - sort_time);
     }
 
@@ -377,45 +670,20 @@ void index_create()
 
         distribute_index_table = (distribute_index_t *)calloc(nb_dpu, sizeof(distribute_index_t));
         assert(distribute_index_table != NULL);
-        struct distribute_index_list head = TAILQ_HEAD_INITIALIZER(head);
+        distribute_init(distribute_index_table, nb_dpu);
 
-        for (unsigned int i = 0; i < nb_dpu; i++) {
-            distribute_index_table[i].dpu_id = i;
-            TAILQ_INSERT_TAIL(&head, &distribute_index_table[i], entries);
-        }
+        for (uint32_t i = 0; i < nb_sorted_seeds; i++) {
+            int seed_code = sorted_seeds[i].seed_code;
+            int nb_seed_counted = sorted_seeds[i].nb_seed;
+            unsigned int nb_chunks;
+            index_seed_t *seed = get_seed_chunks(seed_code, &nb_chunks);
 
-        for (int i = 0; i < NB_SEED; i++) {
-            int seed_code = seed_counter[i].seed_code;
-            int nb_seed_counted = seed_counter[i].nb_seed;
-            index_seed_t *seed = &index_seed[seed_code];
-            if (seed->nb_nbr == 0 && seed->next == NULL) {
-                continue;
-            }
-
-            while (seed != NULL) {
-                distribute_index_t *dpu = TAILQ_LAST(&head, distribute_index_list);
-                TAILQ_REMOVE(&head, dpu, entries);
-                seed->offset = dpu->size;
-                seed->num_dpu = dpu->dpu_id;
-                dpu->size += seed->nb_nbr;
-                dpu->workload += (uint64_t)seed->nb_nbr * (uint64_t)nb_seed_counted;
-                seed = seed->next;
-
-                distribute_index_t *dpu_cmp;
-                bool dpu_inserted = false;
-                TAILQ_FOREACH(dpu_cmp, &head, entries)
-                {
-                    if (dpu->workload >= dpu_cmp->workload) {
-                        TAILQ_INSERT_BEFORE(dpu_cmp, dpu, entries);
-                        dpu_inserted = true;
-                        break;
-                    }
-                }
-                if (!dpu_inserted) {
-                    TAILQ_INSERT_HEAD(&head, dpu, entries);
-                }
+            for (index_seed_t *last_seed = &seed[nb_chunks]; seed != last_seed; seed += 1 + seed->nb_replicas) {
+                distribute_chunk_and_copies(seed, (uint64_t)seed->nb_nbr * (uint64_t)nb_seed_counted);
             }
         }
+        distribute_free();
+        free(sort_buffer);
 
         printf("\t\ttime: %lf s\n", my_clock() - distribute_index_time);
     }
@@ -439,18 +707,13 @@ void index_create()
     {
         double start_time = my_clock();
         printf("\tSaving index on disk\n");
-        FILE *f = fopen(get_index_filename(), "w");
-        CHECK_FILE(f, get_index_filename());
-
-        hashtable_header.nb_seed_total = nb_seed_total;
+        hashtable_header.nb_chunks = nb_chunks_total;
         hashtable_header.nb_dpus = nb_dpu;
-        fwrite(&hashtable_header, sizeof(hashtable_header_t), 1, f);
-
-        adjust_index_seed_next(INDEX_THREAD_SLAVE);
-
-        xfer_file((uint8_t *)index_seed, sizeof(index_seed_t) * nb_seed_total, f, xfer_write);
-
-        fclose(f);
+        hashtable_header.max_seed_occurrences = max_seed_occurrences;
+        hashtable_header.nb_capped_seeds = nb_capped_seeds;
+        hashtable_header.max_chunk_copies = max_chunk_copies;
+        hashtable_header.nb_chunk_copies = nb_chunk_copies;
+        write_index(get_index_filename(), &hashtable_header, index_seed);
         printf("\t\ttime: %lf s\n", my_clock() - start_time);
     }
 
@@ -462,7 +725,150 @@ void index_create()
     printf("\ttime: %lf s\n", my_clock() - start_time);
 }
 
-void index_free() { free(index_seed); }
+uint64_t index_get_nb_chunks() { return index_seed_start[NB_SEED]; }
+
+void index_count_hits(uint8_t *reads, unsigned int nb_reads, uint32_t *chunk_hits)
+{
+    for (unsigned int each_read = 0; each_read < nb_reads; each_read++) {
+        unsigned int seed_position, nb_chunks;
+        index_seed_t *seed = index_get(&reads[each_read * SIZE_READ_IN_BYTES], &seed_position, &nb_chunks);
+        if (nb_chunks == 0) {
+            continue;
+        }
+        uint32_t *hits = &chunk_hits[seed - index_seed];
+        for (unsigned int each_chunk = 0; each_chunk < nb_chunks; each_chunk += 1 + seed[each_chunk].nb_replicas) {
+            if (hits[each_chunk] != UINT32_MAX) {
+                hits[each_chunk]++;
+            }
+        }
+    }
+}
+
+typedef struct {
+    uint64_t cost;
+    uint32_t chunk_id;
+} chunk_cost_t;
+
+static int cmp_chunk_cost(void const *a, void const *b)
+{
+    const chunk_cost_t *chunk_cost_a = (const chunk_cost_t *)a;
+    const chunk_cost_t *chunk_cost_b = (const chunk_cost_t *)b;
+    if (chunk_cost_a->cost != chunk_cost_b->cost) {
+        return chunk_cost_a->cost < chunk_cost_b->cost ? 1 : -1;
+    }
+    return chunk_cost_a->chunk_id < chunk_cost_b->chunk_id ? -1 : 1;
+}
+
+static void print_workloads(const char *name, uint64_t *workloads, unsigned int nb_dpu)
+{
+    uint64_t max_workload = 0, total_workload = 0;
+    for (unsigned int each_dpu = 0; each_dpu < nb_dpu; each_dpu++) {
+        max_workload = workloads[each_dpu] > max_workload ? workloads[each_dpu] : max_workload;
+        total_workload += workloads[each_dpu];
+    }
+    double mean_workload = (double)total_workload / (double)nb_dpu;
+    printf("\t\t%s: max %lu, mean %.0lf comparisons per DPU (max/mean: %.3lf)\n", name, max_workload, mean_workload,
+        mean_workload != 0.0 ? (double)max_workload / mean_workload : 0.0);
+}
+
+void index_rebalance(const uint32_t *chunk_hits, unsigned int nb_dpu)
+{
+    double start_time = my_clock();
+    printf("%s(%u):\n", __func__, nb_dpu);
+    assert(index_mapping != NULL && "The index must be loaded to be rebalanced");
+    assert(nb_dpu <= UINT16_MAX && "Too many DPUs to be numbered in the index");
+    assert(nb_dpu >= ((hashtable_header_t *)index_mapping)->max_chunk_copies && "Not enough DPUs for the copies of the chunks");
+    const uint64_t nb_chunks = index_get_nb_chunks();
+    uint64_t nb_chunks_to_distribute = 0;
+    index_seed_t *new_index_seed;
+    distribute_index_t *distribute_index_table;
+
+    {
+        double distribute_index_time = my_clock();
+        printf("\tDistribute index between DPUs\n");
+
+        /*
+         * A chunk costs the DPU a comparison per neighbour for each request it gets. The chunks no read of the sample
+         * hit are counted as hit once, to still spread them (and the MRAM they take) between the DPUs. The copies of a
+         * chunk share its cost, and are distributed with it.
+         */
+        chunk_cost_t *chunk_costs = (chunk_cost_t *)malloc(nb_chunks * sizeof(chunk_cost_t));
+        assert(chunk_costs != NULL);
+        uint64_t *old_workloads = (uint64_t *)calloc(nb_indexed_dpu, sizeof(uint64_t));
+        assert(old_workloads != NULL);
+        for (uint32_t each_chunk = 0; each_chunk < nb_chunks; each_chunk += 1 + index_seed[each_chunk].nb_replicas) {
+            uint64_t cost = ((uint64_t)chunk_hits[each_chunk] + 1ULL) * (uint64_t)index_seed[each_chunk].nb_nbr;
+            chunk_costs[nb_chunks_to_distribute++] = (chunk_cost_t) { .cost = cost, .chunk_id = each_chunk };
+            for (unsigned int each_copy = 0; each_copy <= index_seed[each_chunk].nb_replicas; each_copy++) {
+                old_workloads[index_seed[each_chunk + each_copy].num_dpu] += cost / (1 + index_seed[each_chunk].nb_replicas);
+            }
+        }
+        /* The most costly chunks first, the cheap ones then even out the workloads of the DPUs */
+        qsort(chunk_costs, nb_chunks_to_distribute, sizeof(chunk_cost_t), cmp_chunk_cost);
+
+        new_index_seed = (index_seed_t *)malloc(nb_chunks * sizeof(index_seed_t));
+        assert(new_index_seed != NULL);
+        memcpy(new_index_seed, index_seed, nb_chunks * sizeof(index_seed_t));
+        distribute_index_table = (distribute_index_t *)calloc(nb_dpu, sizeof(distribute_index_t));
+        assert(distribute_index_table != NULL);
+        distribute_init(distribute_index_table, nb_dpu);
+        for (uint64_t each_chunk = 0; each_chunk < nb_chunks_to_distribute; each_chunk++) {
+            distribute_chunk_and_copies(&new_index_seed[chunk_costs[each_chunk].chunk_id], chunk_costs[each_chunk].cost);
+        }
+        distribute_free();
+
+        uint64_t *new_workloads = (uint64_t *)malloc(nb_dpu * sizeof(uint64_t));
+        assert(new_workloads != NULL);
+        for (unsigned int each_dpu = 0; each_dpu < nb_dpu; each_dpu++) {
+            new_workloads[each_dpu] = distribute_index_table[each_dpu].workload;
+        }
+        print_workloads("before", old_workloads, nb_indexed_dpu);
+        print_workloads("after", new_workloads, nb_dpu);
+
+        free(new_workloads);
+        free(old_workloads);
+        free(chunk_costs);
+        printf("\t\ttime: %lf s\n", my_clock() - distribute_index_time);
+    }
+
+    {
+        double write_in_memories_time = my_clock();
+        printf("\tMoving the neighbours between the DPUs memories\n");
+        mram_move_chunks(nb_indexed_dpu, nb_dpu, distribute_index_table, index_seed, new_index_seed, nb_chunks);
+        free(distribute_index_table);
+        printf("\t\ttime: %lf s\n", my_clock() - write_in_memories_time);
+    }
+
+    {
+        double save_time = my_clock();
+        printf("\tSaving index on disk\n");
+        /* index.bin is still mapped: the new one is written next to it, and replaces it once complete */
+        char *new_index_filename;
+        assert(asprintf(&new_index_filename, "%s.new", get_index_filename()) > 0);
+        hashtable_header_t header = *(hashtable_header_t *)index_mapping;
+        header.nb_dpus = nb_dpu;
+        write_index(new_index_filename, &header, new_index_seed);
+        assert(rename(new_index_filename, get_index_filename()) == 0);
+        free(new_index_filename);
+        free(new_index_seed);
+        printf("\t\ttime: %lf s\n", my_clock() - save_time);
+    }
+
+    printf("\ttime: %lf s\n", my_clock() - start_time);
+}
+
+void index_free()
+{
+    if (index_mapping != NULL) {
+        munmap(index_mapping, index_mapping_size);
+        index_mapping = NULL;
+    } else {
+        free(index_seed_start);
+        free(index_seed);
+    }
+    index_seed_start = NULL;
+    index_seed = NULL;
+}
 
 char *get_index_folder()
 {
@@ -0,0 +1,186 @@
+/**
+ * Copyright 2016-2019 - Dominique Lavenier & UPMEM
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "common.h"
+#include "mram_compress.h"
+
+/**
+ * @brief The MRAM images are compressed by blocks of MRAM_BLOCK_NBR neighbours: a compressed image is the table of the
+ * sizes of its blocks (uint32_t), followed by the blocks. A block which would not get smaller is kept as it is, its size
+ * being then the one it has in the image.
+ *
+ * The neighbours of a chunk are occurrences of the same seed, one after the other, so that each neighbour of a block is
+ * coded from the previous one:
+ *   - the differences of its seq_nr (shifted by one bit, flagging a sparse neighbour) and of its seed_nr, as zigzag
+ *     varints,
+ *   - its SIZE_NEIGHBOUR_IN_BYTES bytes or, when sparse (a repeat of the previous neighbour), the bitmap of the bytes
+ *     differing from the previous neighbour followed by these bytes. The padding of the neighbour is 0 and not coded.
+ */
+#define MRAM_BLOCK_NBR (4096)
+#define MRAM_BLOCK_SIZE (MRAM_BLOCK_NBR * sizeof(coords_and_nbr_t))
+#define NBR_BITMAP_SIZE ((SIZE_NEIGHBOUR_IN_BYTES + 7) / 8)
+#define MAX_VARINT_SIZE (5)
+#define MAX_CODE_SIZE (2 * MAX_VARINT_SIZE + SIZE_NEIGHBOUR_IN_BYTES)
+
+static size_t nb_blocks(size_t size) { return (size + MRAM_BLOCK_SIZE - 1) / MRAM_BLOCK_SIZE; }
+
+size_t mram_compress_bound(size_t size) { return nb_blocks(size) * sizeof(uint32_t) + size; }
+
+static uint32_t zigzag(uint32_t value, uint32_t previous)
+{
+    int32_t delta = (int32_t)(value - previous);
+    return ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+}
+
+static uint32_t unzigzag(uint32_t code, uint32_t previous) { return previous + ((code >> 1) ^ -(code & 1)); }
+
+static uint8_t *put_varint(uint8_t *code, uint64_t value)
+{
+    while (value >= 0x80) {
+        *code++ = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    *code++ = (uint8_t)value;
+    return code;
+}
+
+static uint64_t get_varint(const uint8_t **code, const uint8_t *end)
+{
+    uint64_t value = 0;
+    for (unsigned int shift = 0;; shift += 7) {
+        assert(*code < end && shift < 64 && "Corrupted MRAM image");
+        uint8_t byte = *(*code)++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (byte < 0x80) {
+            return value;
+        }
+    }
+}
+
+/**
+ * @return The size of the "nb_nbr" neighbours of "nbrs" coded into "out", or 0 if they would not get smaller.
+ */
+static size_t compress_block(const coords_and_nbr_t *nbrs, unsigned int nb_nbr, uint8_t *out)
+{
+    static const coords_and_nbr_t first_previous;
+    const size_t size = nb_nbr * sizeof(coords_and_nbr_t);
+    const coords_and_nbr_t *previous = &first_previous;
+    uint8_t *code = out;
+
+    for (unsigned int each_nbr = 0; each_nbr < nb_nbr; previous = &nbrs[each_nbr++]) {
+        const coords_and_nbr_t *nbr = &nbrs[each_nbr];
+        if ((size_t)(code - out) + MAX_CODE_SIZE > size) {
+            return 0;
+        }
+        for (unsigned int each_byte = SIZE_NEIGHBOUR_IN_BYTES; each_byte < sizeof(nbr->nbr); each_byte++) {
+            if (nbr->nbr[each_byte] != 0) {
+                return 0;
+            }
+        }
+
+        uint8_t bitmap[NBR_BITMAP_SIZE] = { 0 };
+        unsigned int nb_diff = 0;
+        for (unsigned int each_byte = 0; each_byte < SIZE_NEIGHBOUR_IN_BYTES; each_byte++) {
+            if (nbr->nbr[each_byte] != previous->nbr[each_byte]) {
+                bitmap[each_byte / 8] |= 1 << (each_byte % 8);
+                nb_diff++;
+            }
+        }
+        bool sparse = NBR_BITMAP_SIZE + nb_diff < SIZE_NEIGHBOUR_IN_BYTES;
+
+        code = put_varint(code, ((uint64_t)zigzag(nbr->coord.seq_nr, previous->coord.seq_nr) << 1) | sparse);
+        code = put_varint(code, zigzag(nbr->coord.seed_nr, previous->coord.seed_nr));
+        if (sparse) {
+            memcpy(code, bitmap, NBR_BITMAP_SIZE);
+            code += NBR_BITMAP_SIZE;
+            for (unsigned int each_byte = 0; each_byte < SIZE_NEIGHBOUR_IN_BYTES; each_byte++) {
+                if (nbr->nbr[each_byte] != previous->nbr[each_byte]) {
+                    *code++ = nbr->nbr[each_byte];
+                }
+            }
+        } else {
+            memcpy(code, nbr->nbr, SIZE_NEIGHBOUR_IN_BYTES);
+            code += SIZE_NEIGHBOUR_IN_BYTES;
+        }
+    }
+    return (size_t)(code - out) < size ? (size_t)(code - out) : 0;
+}
+
+static void decompress_block(const uint8_t *code, size_t code_size, coords_and_nbr_t *nbrs, unsigned int nb_nbr)
+{
+    static const coords_and_nbr_t first_previous;
+    const uint8_t *end = code + code_size;
+    const coords_and_nbr_t *previous = &first_previous;
+
+    for (unsigned int each_nbr = 0; each_nbr < nb_nbr; previous = &nbrs[each_nbr++]) {
+        coords_and_nbr_t *nbr = &nbrs[each_nbr];
+        uint64_t seq_code = get_varint(&code, end);
+        bool sparse = seq_code & 1;
+        nbr->coord.seq_nr = unzigzag((uint32_t)(seq_code >> 1), previous->coord.seq_nr);
+        nbr->coord.seed_nr = unzigzag((uint32_t)get_varint(&code, end), previous->coord.seed_nr);
+        if (sparse) {
+            const uint8_t *bitmap = code;
+            code += NBR_BITMAP_SIZE;
+            memcpy(nbr->nbr, previous->nbr, sizeof(nbr->nbr));
+            for (unsigned int each_byte = 0; each_byte < SIZE_NEIGHBOUR_IN_BYTES; each_byte++) {
+                if (bitmap[each_byte / 8] & (1 << (each_byte % 8))) {
+                    nbr->nbr[each_byte] = *code++;
+                }
+            }
+        } else {
+            memcpy(nbr->nbr, code, SIZE_NEIGHBOUR_IN_BYTES);
+            memset(&nbr->nbr[SIZE_NEIGHBOUR_IN_BYTES], 0, sizeof(nbr->nbr) - SIZE_NEIGHBOUR_IN_BYTES);
+            code += SIZE_NEIGHBOUR_IN_BYTES;
+        }
+        assert(code <= end && "Corrupted MRAM image");
+    }
+    assert(code == end && "Corrupted MRAM image");
+}
+
+size_t mram_compress(const uint8_t *mram, size_t size, uint8_t *out)
+{
+    assert(size % sizeof(coords_and_nbr_t) == 0);
+    uint32_t *block_sizes = (uint32_t *)out;
+    size_t compressed_size = nb_blocks(size) * sizeof(uint32_t);
+
+    for (size_t offset = 0, each_block = 0; offset < size; offset += MRAM_BLOCK_SIZE, each_block++) {
+        size_t block_size = size - offset < MRAM_BLOCK_SIZE ? size - offset : MRAM_BLOCK_SIZE;
+        size_t code_size = compress_block(
+            (const coords_and_nbr_t *)&mram[offset], block_size / sizeof(coords_and_nbr_t), &out[compressed_size]);
+        if (code_size == 0) {
+            memcpy(&out[compressed_size], &mram[offset], block_size);
+            code_size = block_size;
+        }
+        block_sizes[each_block] = code_size;
+        compressed_size += code_size;
+    }
+    return compressed_size;
+}
+
+void mram_decompress(const uint8_t *in, size_t compressed_size, uint8_t *mram, size_t size)
+{
+    assert(size % sizeof(coords_and_nbr_t) == 0);
+    const uint32_t *block_sizes = (const uint32_t *)in;
+    size_t in_offset = nb_blocks(size) * sizeof(uint32_t);
+    assert(in_offset <= compressed_size && "Corrupted MRAM image");
+
+    for (size_t offset = 0, each_block = 0; offset < size; offset += MRAM_BLOCK_SIZE, each_block++) {
+        size_t block_size = size - offset < MRAM_BLOCK_SIZE ? size - offset : MRAM_BLOCK_SIZE;
+        size_t code_size = block_sizes[each_block];
+        assert(in_offset + code_size <= compressed_size && "Corrupted MRAM image");
+        if (code_size == block_size) {
+            memcpy(&mram[offset], &in[in_offset], block_size);
+        } else {
+            decompress_block(
+                &in[in_offset], code_size, (coords_and_nbr_t *)&mram[offset], block_size / sizeof(coords_and_nbr_t));
+        }
+        in_offset += code_size;
+    }
+    assert(in_offset == compressed_size && "Corrupted MRAM image");
+}
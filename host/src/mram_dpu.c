@@ -7,22 +7,27 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include "common.h"
+#include "mram_compress.h"
 #include "mram_dpu.h"
 #include "parse_args.h"
 #include "upvc.h"
 
 #include <dpu.h>
 
-#define MRAM_FORMAT "mram_%04u.bin"
+#define SPILL_FORMAT "mram_%04u.spill"
 #define MRAM_SIZE_AVAILABLE (MRAM_SIZE - MAX_DPU_REQUEST * sizeof(dpu_request_t) - MAX_DPU_RESULTS * sizeof(dpu_result_out_t))
 typedef struct {
     uint32_t size;
@@ -32,46 +37,841 @@ static const size_t mram_size = MRAM_SIZE_AVAILABLE;
 static vmi_t *vmis = NULL;
 _Static_assert(MRAM_SIZE_AVAILABLE > 0, "Too many request and/or result compare to MRAM_SIZE");
 
-static char *make_mram_file_name(unsigned int dpu_id)
+/**
+ * @brief A neighbour of the MRAM image of a DPU, at the index "num_ref" of the image.
+ */
+typedef struct {
+    uint32_t num_ref;
+    coords_and_nbr_t coords_and_nbr;
+} vmi_record_t;
+
+/**
+ * @brief When the MRAM images do not fit in the memory given with -M, the neighbours of each DPU are gathered in a bucket
+ * of spill_bucket_size records, appended to the spill file of the DPU whenever it is full. Each MRAM file is then built
+ * from its spill file alone, in a single image buffer.
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    FILE *f;
+    uint32_t nb_records;
+    vmi_record_t *records;
+} spill_bucket_t;
+static spill_bucket_t *spill_buckets = NULL;
+static uint32_t spill_bucket_size;
+static size_t spill_image_size;
+
+/**
+ * @brief The neighbours of the DPUs helping indexing are staged in host memory, in a buffer per DPU sized after its image,
+ * up to dpu_staging_size records for all of them: their share of -M, or DEFAULT_DPU_STAGING_WINDOWS windows per DPU
+ * without -M. The staging is written to the MRAMs at the end of a block of the genome scan once half full (see
+ * flush_vmis), by windows of DPU_WINDOW_SIZE bytes, each one with a transfer from then to the whole set of DPUs.
+ * Only the windows receiving neighbours are written, and only the ones already written are read back. A DPU whose buffer
+ * fills in the middle of a block is flushed on its own.
+ */
+#define DPU_WINDOW_SIZE ((1 << 18) / sizeof(coords_and_nbr_t) * sizeof(coords_and_nbr_t))
+#define DEFAULT_DPU_STAGING_WINDOWS (32)
+#define DPU_STAGING_MAX_FLUSHES (8)
+typedef struct {
+    pthread_mutex_t mutex;
+    uint32_t nb_records;
+    uint32_t max_records;
+    vmi_record_t *records;
+} dpu_staging_t;
+static dpu_staging_t *dpu_stagings = NULL;
+static uint64_t dpu_staging_size;
+static uint64_t dpu_nb_neighbours;
+static uint8_t *dpu_windows;
+static uint32_t max_dpu_vmi_size;
+static uint32_t nb_dpu_windows;
+static bool *dpu_windows_written;
+static struct dpu_set_t *dpus;
+static pthread_mutex_t dpu_flush_mutex = PTHREAD_MUTEX_INITIALIZER;
+_Static_assert(sizeof(coords_and_nbr_t) % 8 == 0, "MRAM transfers are made of 8-byte words");
+
+/**
+ * @brief The MRAM images of all the DPUs are in the file MRAM_PACK of the index folder: a header, the table of the images
+ * (nb_dpu mram_pack_entry_t), then the images, each one at an offset aligned on MRAM_PACK_ALIGNMENT bytes. An image is
+ * read and written on its own, with pread and pwrite, from as many threads as needed. In a pack created with -z, the
+ * images are compressed (see mram_compress.h), "stored_size" being then the size of the compressed image.
+ */
+#define MRAM_PACK "mrams.pack"
+#define MRAM_PACK_VERSION (2)
+#define MRAM_PACK_ALIGNMENT (4096)
+#define MRAM_PACK_THREAD (8)
+#define MRAM_PACK_COMPRESSED (1 << 0)
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nb_dpu;
+    uint32_t flags;
+} mram_pack_header_t;
+static const mram_pack_header_t mram_pack_header = { .magic = 0x3a3a, .version = MRAM_PACK_VERSION };
+typedef struct {
+    uint64_t offset;
+    uint32_t size;
+    uint32_t stored_size;
+} mram_pack_entry_t;
+typedef struct {
+    int fd;
+    unsigned int nb_dpu;
+    uint32_t flags;
+    mram_pack_entry_t *entries;
+} mram_pack_t;
+static mram_pack_t vmis_pack;
+
+static char *make_index_file_name(const char *format, ...)
 {
+    char *name;
     char *file_name;
+    va_list args;
+    va_start(args, format);
+    assert(vasprintf(&name, format, args) > 0);
+    va_end(args);
     char *index_folder = get_index_folder();
-    assert(asprintf(&file_name, "%s" MRAM_FORMAT, index_folder, dpu_id) > 0);
-    assert(file_name != NULL);
+    assert(asprintf(&file_name, "%s%s", index_folder, name) > 0);
     free(index_folder);
+    free(name);
     return file_name;
 }
 
-size_t mram_load(uint8_t **mram, unsigned int dpu_id)
+static void pwrite_all(int fd, const uint8_t *buffer, size_t size, uint64_t offset)
+{
+    while (size != 0) {
+        ssize_t written = pwrite(fd, buffer, size, offset);
+        assert(written > 0);
+        buffer += written;
+        size -= written;
+        offset += written;
+    }
+}
+
+static void pread_all(int fd, uint8_t *buffer, size_t size, uint64_t offset)
+{
+    while (size != 0) {
+        ssize_t read_size = pread(fd, buffer, size, offset);
+        assert(read_size > 0);
+        buffer += read_size;
+        size -= read_size;
+        offset += read_size;
+    }
+}
+
+typedef void (*for_each_image_fct_t)(unsigned int each_image, void *args);
+typedef struct {
+    unsigned int first_image;
+    unsigned int nb_image;
+    unsigned int nb_thread;
+    unsigned int thread_id;
+    for_each_image_fct_t fct;
+    void *args;
+} for_each_image_args_t;
+
+static void *for_each_image_thread(void *args)
+{
+    for_each_image_args_t *thread_args = (for_each_image_args_t *)args;
+    for (unsigned int each_image = thread_args->first_image + thread_args->thread_id; each_image < thread_args->nb_image;
+         each_image += thread_args->nb_thread) {
+        thread_args->fct(each_image, thread_args->args);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Call "fct" for each image from "first_image" to "nb_image" (excluded), on "nb_thread" threads.
+ */
+static void for_each_image(
+    unsigned int first_image, unsigned int nb_image, unsigned int nb_thread, for_each_image_fct_t fct, void *args)
 {
-    char *file_name = make_mram_file_name(dpu_id);
-    FILE *f = fopen(file_name, "rb");
-    CHECK_FILE(f, file_name);
+    pthread_t thread_ids[nb_thread];
+    for_each_image_args_t thread_args[nb_thread];
+    for (unsigned int each_thread = 0; each_thread < nb_thread; each_thread++) {
+        thread_args[each_thread] = (for_each_image_args_t) { .first_image = first_image,
+            .nb_image = nb_image,
+            .nb_thread = nb_thread,
+            .thread_id = each_thread,
+            .fct = fct,
+            .args = args };
+        assert(pthread_create(&thread_ids[each_thread], NULL, for_each_image_thread, &thread_args[each_thread]) == 0);
+    }
+    for (unsigned int each_thread = 0; each_thread < nb_thread; each_thread++) {
+        assert(pthread_join(thread_ids[each_thread], NULL) == 0);
+    }
+}
+
+/**
+ * @brief Create the pack "file_name" for the images of the "nb_dpu" DPUs of "entries" (of which only the sizes are used),
+ * with its header and table. The images are then written with "write_mram_pack" and the pack closed with
+ * "close_mram_pack".
+ */
+static mram_pack_t create_mram_pack(const char *file_name, unsigned int nb_dpu, const mram_pack_entry_t *entries, uint32_t flags)
+{
+    mram_pack_t pack = { .nb_dpu = nb_dpu, .flags = flags };
+    pack.entries = (mram_pack_entry_t *)malloc(nb_dpu * sizeof(mram_pack_entry_t));
+    assert(pack.entries != NULL);
+
+    uint64_t offset = sizeof(mram_pack_header_t) + nb_dpu * sizeof(mram_pack_entry_t);
+    for (unsigned int each_dpu = 0; each_dpu < nb_dpu; each_dpu++) {
+        offset = (offset + MRAM_PACK_ALIGNMENT - 1) / MRAM_PACK_ALIGNMENT * MRAM_PACK_ALIGNMENT;
+        pack.entries[each_dpu] = entries[each_dpu];
+        pack.entries[each_dpu].offset = offset;
+        assert(pack.entries[each_dpu].size <= mram_size && "Too many neighbours for the MRAM of a DPU");
+        offset += pack.entries[each_dpu].stored_size;
+    }
+
+    pack.fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (pack.fd == -1) {
+        ERROR_EXIT(ERR_FOPEN_FAILED, "Could not open file '%s' (%s)", file_name, strerror(errno));
+    }
+    mram_pack_header_t header = mram_pack_header;
+    header.nb_dpu = nb_dpu;
+    header.flags = flags;
+    pwrite_all(pack.fd, (uint8_t *)&header, sizeof(header), 0);
+    pwrite_all(pack.fd, (uint8_t *)pack.entries, nb_dpu * sizeof(mram_pack_entry_t), sizeof(header));
+    assert(ftruncate(pack.fd, offset) == 0);
+    return pack;
+}
+
+/**
+ * @brief Create the pack "file_name" for the uncompressed images of the "nb_dpu" DPUs of "table".
+ */
+static mram_pack_t create_table_mram_pack(const char *file_name, unsigned int nb_dpu, distribute_index_t *table)
+{
+    mram_pack_entry_t *entries = (mram_pack_entry_t *)calloc(nb_dpu, sizeof(mram_pack_entry_t));
+    assert(entries != NULL);
+    for (unsigned int each_dpu = 0; each_dpu < nb_dpu; each_dpu++) {
+        entries[each_dpu].size = table[each_dpu].size * sizeof(coords_and_nbr_t);
+        entries[each_dpu].stored_size = entries[each_dpu].size;
+    }
+    mram_pack_t pack = create_mram_pack(file_name, nb_dpu, entries, 0);
+    free(entries);
+    return pack;
+}
+
+static void write_mram_pack(mram_pack_t *pack, unsigned int dpu_id, const uint8_t *buffer, uint64_t offset, size_t size)
+{
+    assert(dpu_id < pack->nb_dpu && offset + size <= pack->entries[dpu_id].stored_size);
+    pwrite_all(pack->fd, buffer, size, pack->entries[dpu_id].offset + offset);
+}
+
+static void close_mram_pack(mram_pack_t *pack)
+{
+    assert(close(pack->fd) == 0);
+    free(pack->entries);
+}
+
+static mram_pack_t open_mram_pack(const char *file_name)
+{
+    mram_pack_t pack;
+    pack.fd = open(file_name, O_RDONLY);
+    if (pack.fd == -1) {
+        ERROR_EXIT(ERR_FOPEN_FAILED, "Could not open file '%s' (%s)", file_name, strerror(errno));
+    }
+
+    mram_pack_header_t header;
+    pread_all(pack.fd, (uint8_t *)&header, sizeof(mram_pack_header_t), 0);
+    assert(header.magic == mram_pack_header.magic && "Wrong header for the MRAM images");
+    assert(header.version == mram_pack_header.version
+        && "Could not load MRAM images generated with a different version of UPVC.");
+    pack.nb_dpu = header.nb_dpu;
+    pack.flags = header.flags;
+    size_t table_size = pack.nb_dpu * sizeof(mram_pack_entry_t);
+    pack.entries = (mram_pack_entry_t *)malloc(table_size);
+    assert(pack.entries != NULL);
+    pread_all(pack.fd, (uint8_t *)pack.entries, table_size, sizeof(mram_pack_header_t));
+    return pack;
+}
+
+/**
+ * @brief Read the image of the DPU "dpu_id" from "pack" into "mram", decompressing it if needed.
+ *
+ * @return The size of the image.
+ */
+static size_t read_mram_pack(mram_pack_t *pack, unsigned int dpu_id, uint8_t *mram)
+{
+    assert(dpu_id < pack->nb_dpu);
+    mram_pack_entry_t *entry = &pack->entries[dpu_id];
+    assert(mram_size >= entry->size);
+    if (!(pack->flags & MRAM_PACK_COMPRESSED)) {
+        pread_all(pack->fd, mram, entry->size, entry->offset);
+        return entry->size;
+    }
+
+    uint8_t *compressed_mram = (uint8_t *)malloc(entry->stored_size);
+    assert(compressed_mram != NULL);
+    pread_all(pack->fd, compressed_mram, entry->stored_size, entry->offset);
+    mram_decompress(compressed_mram, entry->stored_size, mram, entry->size);
+    free(compressed_mram);
+    return entry->size;
+}
+
+typedef struct {
+    mram_pack_t *src;
+    mram_pack_t *dst;
+    mram_pack_entry_t *entries;
+    bool compress;
+} convert_mram_pack_args_t;
+
+static void size_compressed_image(unsigned int dpu_id, void *args)
+{
+    convert_mram_pack_args_t *convert_args = (convert_mram_pack_args_t *)args;
+    uint8_t *mram = (uint8_t *)malloc(mram_size);
+    uint8_t *compressed_mram = (uint8_t *)malloc(mram_compress_bound(mram_size));
+    assert(mram != NULL && compressed_mram != NULL);
+
+    size_t size = read_mram_pack(convert_args->src, dpu_id, mram);
+    convert_args->entries[dpu_id].stored_size = mram_compress(mram, size, compressed_mram);
+    free(compressed_mram);
+    free(mram);
+}
+
+static void write_converted_image(unsigned int dpu_id, void *args)
+{
+    convert_mram_pack_args_t *convert_args = (convert_mram_pack_args_t *)args;
+    uint8_t *mram = (uint8_t *)malloc(mram_size);
+    assert(mram != NULL);
+
+    size_t size = read_mram_pack(convert_args->src, dpu_id, mram);
+    if (convert_args->compress) {
+        uint8_t *compressed_mram = (uint8_t *)malloc(mram_compress_bound(mram_size));
+        assert(compressed_mram != NULL);
+        size_t compressed_size = mram_compress(mram, size, compressed_mram);
+        write_mram_pack(convert_args->dst, dpu_id, compressed_mram, 0, compressed_size);
+        free(compressed_mram);
+    } else {
+        write_mram_pack(convert_args->dst, dpu_id, mram, 0, size);
+    }
+    free(mram);
+}
+
+/**
+ * @brief Write the images of the pack "src_file_name" to the pack "dst_file_name", compressed or not. The images are
+ * compressed twice, a first time for the table of the new pack, so that each thread has a single image in memory (within
+ * the memory given with -M).
+ */
+static void convert_mram_pack(const char *src_file_name, const char *dst_file_name, bool compress)
+{
+    mram_pack_t src_pack = open_mram_pack(src_file_name);
+    mram_pack_entry_t *entries = (mram_pack_entry_t *)calloc(src_pack.nb_dpu, sizeof(mram_pack_entry_t));
+    assert(entries != NULL);
+    for (unsigned int each_dpu = 0; each_dpu < src_pack.nb_dpu; each_dpu++) {
+        entries[each_dpu].size = src_pack.entries[each_dpu].size;
+        entries[each_dpu].stored_size = entries[each_dpu].size;
+    }
+
+    unsigned int nb_thread = MRAM_PACK_THREAD;
+    size_t max_memory = (size_t)get_index_max_memory() << 20;
+    if (max_memory != 0) {
+        size_t thread_memory = mram_size + (compress ? mram_compress_bound(mram_size) : 0);
+        nb_thread = max_memory / thread_memory < nb_thread ? max_memory / thread_memory : nb_thread;
+        nb_thread = nb_thread != 0 ? nb_thread : 1;
+    }
+
+    convert_mram_pack_args_t args = { .src = &src_pack, .entries = entries, .compress = compress };
+    if (compress) {
+        for_each_image(0, src_pack.nb_dpu, nb_thread, size_compressed_image, &args);
+    }
+    mram_pack_t dst_pack = create_mram_pack(dst_file_name, src_pack.nb_dpu, entries, compress ? MRAM_PACK_COMPRESSED : 0);
+    args.dst = &dst_pack;
+    for_each_image(0, src_pack.nb_dpu, nb_thread, write_converted_image, &args);
+
+    if (compress) {
+        uint64_t total_size = 0, total_stored_size = 0;
+        for (unsigned int each_dpu = 0; each_dpu < src_pack.nb_dpu; each_dpu++) {
+            total_size += entries[each_dpu].size;
+            total_stored_size += entries[each_dpu].stored_size;
+        }
+        printf("\t\tMRAM images compressed from %lu to %lu MB (%.3lf)\n", total_size >> 20, total_stored_size >> 20,
+            total_size != 0 ? (double)total_stored_size / (double)total_size : 1.0);
+    }
+    close_mram_pack(&dst_pack);
+    close_mram_pack(&src_pack);
+    free(entries);
+}
+
+static mram_pack_t loaded_pack;
+static pthread_once_t loaded_pack_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief With the goal preload, the MRAM images of the index are decompressed once in the POSIX shared memory object
+ * MRAM_CACHE_FORMAT (named from the path of the index folder), which outlives the process: the runs mapping reads on the
+ * same index then take their images from it, without reading nor copying them, as long as the pack they were preloaded
+ * from is unchanged. The object has the header and the table of a pack (with the offsets in the object), and is replaced
+ * by the next preload of the index.
+ */
+#define MRAM_CACHE_FORMAT "/upvc_mrams_%016lx"
+#define MRAM_CACHE_VERSION (1)
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nb_dpu;
+    uint32_t ready;
+    uint64_t pack_dev;
+    uint64_t pack_ino;
+    uint64_t pack_size;
+    uint64_t pack_mtime;
+} mram_cache_header_t;
+static uint8_t *mram_cache = NULL;
+static size_t mram_cache_size;
+
+static char *make_mram_cache_name()
+{
+    char *index_folder = get_index_folder();
+    char *path = realpath(index_folder, NULL);
+    if (path == NULL) {
+        ERROR_EXIT(ERR_FOPEN_FAILED, "Could not find folder '%s' (%s)", index_folder, strerror(errno));
+    }
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char *c = path; *c != '\0'; c++) {
+        hash = (hash ^ (uint8_t)*c) * 0x100000001b3ULL;
+    }
+    char *cache_name;
+    assert(asprintf(&cache_name, MRAM_CACHE_FORMAT, hash) > 0);
+    free(path);
+    free(index_folder);
+    return cache_name;
+}
+
+static mram_cache_header_t make_mram_cache_header(mram_pack_t *pack)
+{
+    struct stat pack_stat;
+    assert(fstat(pack->fd, &pack_stat) == 0);
+    return (mram_cache_header_t) { .magic = mram_pack_header.magic,
+        .version = MRAM_CACHE_VERSION,
+        .nb_dpu = pack->nb_dpu,
+        .ready = 1,
+        .pack_dev = pack_stat.st_dev,
+        .pack_ino = pack_stat.st_ino,
+        .pack_size = pack_stat.st_size,
+        .pack_mtime = pack_stat.st_mtim.tv_sec * 1000000000ULL + pack_stat.st_mtim.tv_nsec };
+}
+
+typedef struct {
+    mram_pack_t *pack;
+    mram_pack_entry_t *entries;
+    uint8_t *cache;
+} preload_args_t;
+
+static void preload_image(unsigned int dpu_id, void *args)
+{
+    preload_args_t *preload_args = (preload_args_t *)args;
+    read_mram_pack(preload_args->pack, dpu_id, &preload_args->cache[preload_args->entries[dpu_id].offset]);
+}
+
+void mram_preload()
+{
+    char *file_name = make_index_file_name(MRAM_PACK);
+    mram_pack_t pack = open_mram_pack(file_name);
     free(file_name);
+    char *cache_name = make_mram_cache_name();
+    mram_cache_header_t header = make_mram_cache_header(&pack);
+
+    size_t table_size = pack.nb_dpu * sizeof(mram_pack_entry_t);
+    mram_pack_entry_t *entries = (mram_pack_entry_t *)malloc(table_size);
+    assert(entries != NULL && pack.nb_dpu != 0);
+    uint64_t offset = sizeof(mram_cache_header_t) + table_size;
+    uint32_t max_size = 0;
+    for (unsigned int each_dpu = 0; each_dpu < pack.nb_dpu; each_dpu++) {
+        offset = (offset + MRAM_PACK_ALIGNMENT - 1) / MRAM_PACK_ALIGNMENT * MRAM_PACK_ALIGNMENT;
+        entries[each_dpu] = (mram_pack_entry_t) {
+            .offset = offset, .size = pack.entries[each_dpu].size, .stored_size = pack.entries[each_dpu].size
+        };
+        offset += entries[each_dpu].size;
+        max_size = entries[each_dpu].size > max_size ? entries[each_dpu].size : max_size;
+    }
+    /* The images of a rank are transferred to its DPUs as large as the largest one */
+    size_t cache_size = offset + max_size - entries[pack.nb_dpu - 1].size;
+
+    /* The runs using the object being replaced keep it until they end */
+    if (shm_unlink(cache_name) != 0 && errno != ENOENT) {
+        ERROR_EXIT(ERR_MRAM_CACHE_FAILED, "Could not remove shared memory object '%s' (%s)", cache_name, strerror(errno));
+    }
+    int fd = shm_open(cache_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd == -1) {
+        ERROR_EXIT(ERR_MRAM_CACHE_FAILED, "Could not create shared memory object '%s' (%s)", cache_name, strerror(errno));
+    }
+    int err = posix_fallocate(fd, 0, cache_size);
+    if (err != 0) {
+        shm_unlink(cache_name);
+        ERROR_EXIT(ERR_MRAM_CACHE_FAILED, "Could not allocate %lu MB of shared memory for '%s' (%s)", (cache_size >> 20) + 1,
+            cache_name, strerror(err));
+    }
+    uint8_t *cache = mmap(NULL, cache_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    assert(cache != MAP_FAILED);
+    close(fd);
+    /* Transparent huge pages, when enabled for shared memory */
+    madvise(cache, cache_size, MADV_HUGEPAGE);
+
+    memcpy(&cache[sizeof(mram_cache_header_t)], entries, table_size);
+    preload_args_t args = { .pack = &pack, .entries = entries, .cache = cache };
+    for_each_image(0, pack.nb_dpu, pack.nb_dpu < MRAM_PACK_THREAD ? pack.nb_dpu : MRAM_PACK_THREAD, preload_image, &args);
+    /* The header comes last, for the object to be used only once complete */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(cache, &header, sizeof(mram_cache_header_t));
+    printf("\tMRAM images of %u DPUs cached in shared memory object %s (%lu MB)\n", pack.nb_dpu, cache_name,
+        (cache_size >> 20) + 1);
 
-    fseek(f, 0, SEEK_END);
-    size_t size = ftell(f);
-    rewind(f);
+    munmap(cache, cache_size);
+    close_mram_pack(&pack);
+    free(entries);
+    free(cache_name);
+}
+
+static void open_mram_cache()
+{
+    char *cache_name = make_mram_cache_name();
+    int fd = shm_open(cache_name, O_RDONLY, 0);
+    if (fd == -1) {
+        free(cache_name);
+        return;
+    }
+    struct stat cache_stat;
+    assert(fstat(fd, &cache_stat) == 0);
+    mram_cache_header_t header = make_mram_cache_header(&loaded_pack);
+    uint8_t *cache = MAP_FAILED;
+    if ((size_t)cache_stat.st_size >= sizeof(mram_cache_header_t) + loaded_pack.nb_dpu * sizeof(mram_pack_entry_t)) {
+        cache = mmap(NULL, cache_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (cache != MAP_FAILED && memcmp(cache, &header, sizeof(mram_cache_header_t)) == 0) {
+        mram_cache = cache;
+        mram_cache_size = cache_stat.st_size;
+        printf("\tMRAM images taken from shared memory object %s\n", cache_name);
+    } else {
+        if (cache != MAP_FAILED) {
+            munmap(cache, cache_stat.st_size);
+        }
+        WARNING("MRAM images in shared memory object %s not preloaded from the index as it is", cache_name);
+    }
+    free(cache_name);
+}
 
-    assert(mram_size >= size);
+static void open_loaded_pack()
+{
+    char *file_name = make_index_file_name(MRAM_PACK);
+    loaded_pack = open_mram_pack(file_name);
+    free(file_name);
+    open_mram_cache();
+}
+
+size_t mram_load(uint8_t **mram, unsigned int dpu_id)
+{
+    assert(pthread_once(&loaded_pack_once, open_loaded_pack) == 0);
+    if (mram_cache != NULL) {
+        assert(dpu_id < loaded_pack.nb_dpu);
+        mram_pack_entry_t *entry = &((mram_pack_entry_t *)&mram_cache[sizeof(mram_cache_header_t)])[dpu_id];
+        *mram = &mram_cache[entry->offset];
+        return entry->size;
+    }
     *mram = malloc(mram_size);
     assert(*mram != NULL);
+    return read_mram_pack(&loaded_pack, dpu_id, *mram);
+}
+
+void mram_free(uint8_t *mram)
+{
+    if (mram_cache == NULL || (uintptr_t)mram < (uintptr_t)mram_cache
+        || (uintptr_t)mram >= (uintptr_t)mram_cache + mram_cache_size) {
+        free(mram);
+    }
+}
 
-    size_t read_size = fread(*mram, sizeof(uint8_t), size, f);
-    assert(read_size == size);
+typedef struct {
+    const unsigned int *dpu_ids;
+    uint8_t **mrams;
+    size_t *sizes;
+} mram_load_all_args_t;
+
+static void mram_load_image(unsigned int each_mram, void *args)
+{
+    mram_load_all_args_t *load_args = (mram_load_all_args_t *)args;
+    if (load_args->dpu_ids[each_mram] < loaded_pack.nb_dpu) {
+        load_args->sizes[each_mram] = mram_load(&load_args->mrams[each_mram], load_args->dpu_ids[each_mram]);
+    }
+}
 
-    fclose(f);
-    return read_size;
+void mram_load_all(unsigned int nb_mram, const unsigned int *dpu_ids, uint8_t **mrams, size_t *sizes)
+{
+    assert(pthread_once(&loaded_pack_once, open_loaded_pack) == 0);
+    mram_load_all_args_t args = { .dpu_ids = dpu_ids, .mrams = mrams, .sizes = sizes };
+    for_each_image(0, nb_mram, nb_mram < MRAM_PACK_THREAD ? nb_mram : MRAM_PACK_THREAD, mram_load_image, &args);
 }
 
 static struct dpu_set_t dpu_set;
-static struct dpu_set_t *dpus;
 static uint32_t nb_dpu_set;
 static struct dpu_symbol_t mram_symbol = { .address = 0x08000000, .size = MRAM_SIZE };
 
+static int cmp_vmi_record(const void *a, const void *b)
+{
+    uint32_t num_ref_a = ((const vmi_record_t *)a)->num_ref;
+    uint32_t num_ref_b = ((const vmi_record_t *)b)->num_ref;
+    return (num_ref_a > num_ref_b) - (num_ref_a < num_ref_b);
+}
+
+static void init_dpu_stagings(size_t max_memory)
+{
+    size_t windows_size = (size_t)nb_dpu_set * DPU_WINDOW_SIZE;
+    uint64_t dpu_total_size = 0;
+    for (unsigned int dpuno = 0; dpuno < nb_dpu_set; dpuno++) {
+        dpu_total_size += vmis[dpuno].size;
+    }
+    dpu_nb_neighbours = dpu_total_size / sizeof(coords_and_nbr_t);
+    bool default_memory = max_memory == 0;
+    if (default_memory) {
+        max_memory = windows_size * (1 + DEFAULT_DPU_STAGING_WINDOWS) + (size_t)nb_dpu_set * sizeof(vmi_record_t);
+    }
+    if (max_memory <= windows_size + (size_t)nb_dpu_set * sizeof(vmi_record_t)) {
+        ERROR_EXIT(ERR_INDEX_MAX_MEMORY_TOO_LOW, "At least %lu MB are needed to stage the neighbours of %u DPUs",
+            (windows_size + (size_t)nb_dpu_set * sizeof(vmi_record_t)) / (1 << 20) + 1, nb_dpu_set);
+    }
+    dpu_staging_size = (max_memory - windows_size) / sizeof(vmi_record_t) - nb_dpu_set;
+    uint64_t nb_flushes = (2 * dpu_nb_neighbours + dpu_staging_size - 1) / dpu_staging_size;
+    printf("\t\tStaging %lu neighbours of the DPUs, about %lu flushes to the MRAMs\n", dpu_staging_size, nb_flushes);
+    if (!default_memory && nb_flushes > DPU_STAGING_MAX_FLUSHES) {
+        printf("\t\tWARNING: each flush reads back the MRAM windows it updates, a higher -M would need less of them\n");
+    }
+
+    nb_dpu_windows = (max_dpu_vmi_size + DPU_WINDOW_SIZE - 1) / DPU_WINDOW_SIZE;
+    dpu_windows = (uint8_t *)calloc(nb_dpu_set, DPU_WINDOW_SIZE);
+    dpu_windows_written = (bool *)calloc((size_t)nb_dpu_set * nb_dpu_windows + 1, sizeof(bool));
+    dpu_stagings = (dpu_staging_t *)calloc(nb_dpu_set, sizeof(dpu_staging_t));
+    dpus = (struct dpu_set_t *)calloc(nb_dpu_set, sizeof(struct dpu_set_t));
+    assert(dpu_windows != NULL && dpu_windows_written != NULL && dpu_stagings != NULL && dpus != NULL);
+
+    struct dpu_set_t dpu;
+    uint32_t each_dpu;
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        if (each_dpu >= nb_dpu_set) {
+            break;
+        }
+        dpus[each_dpu] = dpu;
+    }
+    for (unsigned int dpuno = 0; dpuno < nb_dpu_set; dpuno++) {
+        dpu_staging_t *staging = &dpu_stagings[dpuno];
+        /* Each DPU gets the share of the staging of its image */
+        staging->max_records = dpu_total_size != 0 ? dpu_staging_size * vmis[dpuno].size / dpu_total_size + 1 : 1;
+        staging->records = (vmi_record_t *)malloc(staging->max_records * sizeof(vmi_record_t));
+        assert(staging->records != NULL);
+        assert(pthread_mutex_init(&staging->mutex, NULL) == 0);
+    }
+}
+
+static void push_dpu_windows(dpu_xfer_t direction, uint32_t offset, uint32_t size)
+{
+    for (unsigned int dpuno = 0; dpuno < nb_dpu_set; dpuno++) {
+        DPU_ASSERT(dpu_prepare_xfer(dpus[dpuno], &dpu_windows[(size_t)dpuno * DPU_WINDOW_SIZE]));
+    }
+    DPU_ASSERT(dpu_push_xfer_symbol(dpu_set, direction, mram_symbol, offset, size, DPU_XFER_DEFAULT));
+}
+
+/**
+ * @brief Patch "window", at "offset" in the MRAM of DPU "dpuno", with its records staged from "*next_record" on.
+ *
+ * @return Whether a record was patched.
+ */
+static bool patch_dpu_window(unsigned int dpuno, uint8_t *window, uint32_t offset, uint32_t size, uint32_t *next_record)
+{
+    dpu_staging_t *staging = &dpu_stagings[dpuno];
+    uint32_t first_record = *next_record;
+    for (; *next_record < staging->nb_records; (*next_record)++) {
+        vmi_record_t *record = &staging->records[*next_record];
+        uint32_t record_offset = record->num_ref * sizeof(coords_and_nbr_t);
+        if (record_offset >= offset + size) {
+            break;
+        }
+        memcpy(&window[record_offset - offset], &record->coords_and_nbr, sizeof(coords_and_nbr_t));
+    }
+    return *next_record != first_record;
+}
+
+static bool dpu_window_has_records(unsigned int dpuno, uint32_t offset, uint32_t size, uint32_t next_record)
+{
+    dpu_staging_t *staging = &dpu_stagings[dpuno];
+    return next_record < staging->nb_records && staging->records[next_record].num_ref * sizeof(coords_and_nbr_t) < offset + size;
+}
+
+/**
+ * @brief Write the neighbours staged to the MRAMs of the DPUs helping indexing, or to the pack of the MRAM images if
+ * "to_pack". Only the windows receiving neighbours are written to the MRAMs, the ones already written being read first.
+ */
+static void flush_dpu_stagings(bool to_pack)
+{
+    uint32_t *next_records = (uint32_t *)calloc(nb_dpu_set, sizeof(uint32_t));
+    assert(next_records != NULL);
+    for (unsigned int dpuno = 0; dpuno < nb_dpu_set; dpuno++) {
+        qsort(dpu_stagings[dpuno].records, dpu_stagings[dpuno].nb_records, sizeof(vmi_record_t), cmp_vmi_record);
+    }
+
+    for (uint32_t each_window = 0; each_window < nb_dpu_windows; each_window++) {
+        uint32_t offset = each_window * DPU_WINDOW_SIZE;
+        uint32_t size = max_dpu_vmi_size - offset < DPU_WINDOW_SIZE ? max_dpu_vmi_size - offset : DPU_WINDOW_SIZE;
+        bool has_records = false, written = false;
+        for (unsigned int dpuno = 0; dpuno < nb_dpu_set; dpuno++) {
+            has_records |= dpu_window_has_records(dpuno, offset, size, next_records[dpuno]);
+            written |= dpu_windows_written[(size_t)dpuno * nb_dpu_windows + each_window];
+        }
+        if (!to_pack && !has_records) {
+            continue;
+        }
+        if (written) {
+            push_dpu_windows(DPU_XFER_FROM_DPU, offset, size);
+        }
+        for (unsigned int dpuno = 0; dpuno < nb_dpu_set; dpuno++) {
+            uint8_t *window = &dpu_windows[(size_t)dpuno * DPU_WINDOW_SIZE];
+            if (!dpu_windows_written[(size_t)dpuno * nb_dpu_windows + each_window]) {
+                memset(window, 0, size);
+            }
+            patch_dpu_window(dpuno, window, offset, size, &next_records[dpuno]);
+            if (to_pack && offset < vmis[dpuno].size) {
+                uint32_t dpu_size = vmis[dpuno].size - offset < size ? vmis[dpuno].size - offset : size;
+                write_mram_pack(&vmis_pack, dpuno, window, offset, dpu_size);
+            }
+        }
+        if (!to_pack) {
+            push_dpu_windows(DPU_XFER_TO_DPU, offset, size);
+            for (unsigned int dpuno = 0; dpuno < nb_dpu_set; dpuno++) {
+                dpu_windows_written[(size_t)dpuno * nb_dpu_windows + each_window] = true;
+            }
+        }
+    }
+
+    for (unsigned int dpuno = 0; dpuno < nb_dpu_set; dpuno++) {
+        dpu_stagings[dpuno].nb_records = 0;
+    }
+    free(next_records);
+}
+
+/**
+ * @brief Write the neighbours staged for DPU "dpuno" to its MRAM, while the other DPUs are still being written to.
+ */
+static void flush_dpu_staging(unsigned int dpuno)
+{
+    dpu_staging_t *staging = &dpu_stagings[dpuno];
+    uint8_t *window = &dpu_windows[(size_t)dpuno * DPU_WINDOW_SIZE];
+    uint32_t next_record = 0;
+    qsort(staging->records, staging->nb_records, sizeof(vmi_record_t), cmp_vmi_record);
+
+    pthread_mutex_lock(&dpu_flush_mutex);
+    while (next_record < staging->nb_records) {
+        uint32_t each_window = staging->records[next_record].num_ref * sizeof(coords_and_nbr_t) / DPU_WINDOW_SIZE;
+        uint32_t offset = each_window * DPU_WINDOW_SIZE;
+        uint32_t size = vmis[dpuno].size - offset < DPU_WINDOW_SIZE ? vmis[dpuno].size - offset : DPU_WINDOW_SIZE;
+        bool *written = &dpu_windows_written[(size_t)dpuno * nb_dpu_windows + each_window];
+        if (*written) {
+            DPU_ASSERT(dpu_copy_from_symbol(dpus[dpuno], mram_symbol, offset, window, size));
+        } else {
+            memset(window, 0, size);
+        }
+        patch_dpu_window(dpuno, window, offset, size, &next_record);
+        DPU_ASSERT(dpu_copy_to_symbol(dpus[dpuno], mram_symbol, offset, window, size));
+        *written = true;
+    }
+    pthread_mutex_unlock(&dpu_flush_mutex);
+    staging->nb_records = 0;
+}
+
+void flush_vmis()
+{
+    if (dpu_stagings == NULL) {
+        return;
+    }
+    uint64_t nb_records = 0;
+    for (unsigned int dpuno = 0; dpuno < nb_dpu_set; dpuno++) {
+        nb_records += dpu_stagings[dpuno].nb_records;
+    }
+    /* The other half of the staging takes the next block */
+    if (nb_records >= dpu_staging_size / 2) {
+        flush_dpu_stagings(false);
+    }
+}
+
+static void free_dpu_stagings()
+{
+    /* The last neighbours staged go with the windows read back from the MRAMs straight to the pack */
+    flush_dpu_stagings(true);
+
+    for (unsigned int dpuno = 0; dpuno < nb_dpu_set; dpuno++) {
+        free(dpu_stagings[dpuno].records);
+        pthread_mutex_destroy(&dpu_stagings[dpuno].mutex);
+    }
+    free(dpu_stagings);
+    free(dpu_windows);
+    free(dpu_windows_written);
+    free(dpus);
+    dpu_stagings = NULL;
+    DPU_ASSERT(dpu_free(dpu_set));
+}
+
+static void init_spill_buckets(unsigned int nb_dpu, size_t max_memory, size_t max_vmi_size)
+{
+    unsigned int nb_spilled_dpu = nb_dpu - nb_dpu_set;
+    /* The image of one MRAM is built at a time from its spill file, in a buffer of the size of the largest one */
+    spill_image_size = max_vmi_size;
+    if (max_memory > max_vmi_size) {
+        spill_bucket_size = (max_memory - max_vmi_size) / ((size_t)nb_spilled_dpu * sizeof(vmi_record_t));
+    } else {
+        spill_bucket_size = 0;
+    }
+    if (spill_bucket_size == 0) {
+        ERROR_EXIT(ERR_INDEX_MAX_MEMORY_TOO_LOW, "At least %lu MB are needed to build the MRAM images of %u DPUs",
+            (max_vmi_size + (size_t)nb_spilled_dpu * sizeof(vmi_record_t)) / (1 << 20) + 1, nb_spilled_dpu);
+    }
+    printf("\t\tSpilling the neighbours of %u DPUs to the index folder (%u per bucket)\n", nb_spilled_dpu, spill_bucket_size);
+    check_ulimit_n(nb_spilled_dpu + 16);
+
+    spill_buckets = (spill_bucket_t *)calloc(nb_dpu, sizeof(spill_bucket_t));
+    assert(spill_buckets != NULL);
+    for (unsigned int i = nb_dpu_set; i < nb_dpu; i++) {
+        char *file_name = make_index_file_name(SPILL_FORMAT, i);
+        spill_buckets[i].f = fopen(file_name, "w+");
+        CHECK_FILE(spill_buckets[i].f, file_name);
+        free(file_name);
+        spill_buckets[i].records = (vmi_record_t *)malloc(spill_bucket_size * sizeof(vmi_record_t));
+        assert(spill_buckets[i].records != NULL);
+        assert(pthread_mutex_init(&spill_buckets[i].mutex, NULL) == 0);
+    }
+}
+
+static void place_spill_records(uint8_t *mram, vmi_record_t *records, uint32_t nb_records)
+{
+    for (uint32_t each_record = 0; each_record < nb_records; each_record++) {
+        memcpy(&mram[sizeof(coords_and_nbr_t) * records[each_record].num_ref], &records[each_record].coords_and_nbr,
+            sizeof(coords_and_nbr_t));
+    }
+}
+
+/**
+ * @brief Build the MRAM image of DPU "dpuno" from the records left in its bucket and from the ones of its spill file.
+ */
+static void finalize_spill_bucket(unsigned int dpuno, uint8_t *mram)
+{
+    spill_bucket_t *bucket = &spill_buckets[dpuno];
+    memset(mram, 0, vmis[dpuno].size);
+    place_spill_records(mram, bucket->records, bucket->nb_records);
+
+    size_t spill_size = ftell(bucket->f);
+    size_t bucket_size = spill_bucket_size * sizeof(vmi_record_t);
+    rewind(bucket->f);
+    for (size_t done = 0; done < spill_size;) {
+        size_t size = spill_size - done < bucket_size ? spill_size - done : bucket_size;
+        xfer_file((uint8_t *)bucket->records, size, bucket->f, xfer_read);
+        place_spill_records(mram, bucket->records, size / sizeof(vmi_record_t));
+        done += size;
+    }
+
+    fclose(bucket->f);
+    char *file_name = make_index_file_name(SPILL_FORMAT, dpuno);
+    assert(unlink(file_name) == 0);
+    free(file_name);
+    free(bucket->records);
+    pthread_mutex_destroy(&bucket->mutex);
+}
+
 void init_vmis(unsigned int nb_dpu, distribute_index_t *table)
 {
-    check_ulimit_n(nb_dpu + 16);
+    char *pack_file_name = make_index_file_name(MRAM_PACK);
+    vmis_pack = create_table_mram_pack(pack_file_name, nb_dpu, table);
+    free(pack_file_name);
 
     vmis = (vmi_t *)calloc(nb_dpu, sizeof(vmi_t));
     assert(vmis != NULL);
@@ -81,60 +881,86 @@ void init_vmis(unsigned int nb_dpu, distribute_index_t *table)
         err = dpu_alloc(DPU_ALLOCATE_ALL, "backend=hw", &dpu_set);
     }
     if (err == DPU_OK) {
-        struct dpu_set_t dpu;
-        uint32_t each_dpu;
         DPU_ASSERT(dpu_get_nr_dpus(dpu_set, &nb_dpu_set));
         printf("\t\tUsing %u DPUs to help indexing\n", nb_dpu_set);
         if (nb_dpu_set > nb_dpu) {
             nb_dpu_set = nb_dpu;
         }
-        dpus = (struct dpu_set_t *)malloc(sizeof(struct dpu_set_t) * nb_dpu_set);
-        assert(dpus != NULL);
-        DPU_FOREACH (dpu_set, dpu, each_dpu) {
-            if (each_dpu >= nb_dpu_set) {
-                break;
-            }
-            dpus[each_dpu] = dpu;
-        }
     } else {
         nb_dpu_set = 0;
     }
 
+    size_t total_vmi_size = 0;
+    size_t max_vmi_size = 0;
+    max_dpu_vmi_size = 0;
     for (unsigned int i = 0; i < nb_dpu; i++) {
         vmis[i].size = table[i].size * sizeof(coords_and_nbr_t);
         assert(vmis[i].size < MRAM_SIZE);
         if (i >= nb_dpu_set) {
-            vmis[i].buffer = (uint8_t *)malloc(vmis[i].size);
-            assert(vmis[i].buffer != NULL);
+            total_vmi_size += vmis[i].size;
+            max_vmi_size = vmis[i].size > max_vmi_size ? vmis[i].size : max_vmi_size;
+        } else {
+            max_dpu_vmi_size = vmis[i].size > max_dpu_vmi_size ? vmis[i].size : max_dpu_vmi_size;
         }
     }
+
+    size_t max_memory = (size_t)get_index_max_memory() << 20;
+    if (nb_dpu_set != 0) {
+        /* The DPUs helping indexing take their share of the memory given with -M */
+        size_t dpu_max_memory = max_memory / nb_dpu * nb_dpu_set;
+        init_dpu_stagings(dpu_max_memory);
+        max_memory -= dpu_max_memory;
+    }
+    if (max_memory != 0 && total_vmi_size > max_memory) {
+        init_spill_buckets(nb_dpu, max_memory, max_vmi_size);
+        return;
+    }
+    for (unsigned int i = nb_dpu_set; i < nb_dpu; i++) {
+        vmis[i].buffer = (uint8_t *)malloc(vmis[i].size);
+        assert(vmis[i].buffer != NULL);
+    }
+}
+
+static void write_vmi_image(unsigned int dpuno, __attribute__((unused)) void *args)
+{
+    write_mram_pack(&vmis_pack, dpuno, vmis[dpuno].buffer, 0, vmis[dpuno].size);
+    free(vmis[dpuno].buffer);
 }
 
 void free_vmis(unsigned int nb_dpu)
 {
-    uint8_t *tmp_mram = (uint8_t *)malloc(MRAM_SIZE);
-    assert(tmp_mram != NULL);
-    for (unsigned int dpuno = 0; dpuno < nb_dpu_set; dpuno++) {
-        char *file_name = make_mram_file_name(dpuno);
-        FILE *f = fopen(file_name, "w");
-        CHECK_FILE(f, file_name);
-        free(file_name);
-        DPU_ASSERT(dpu_copy_from_symbol(dpus[dpuno], mram_symbol, 0, tmp_mram, vmis[dpuno].size));
-        xfer_file(tmp_mram, vmis[dpuno].size, f, xfer_write);
-        fclose(f);
-    }
-    for (unsigned int dpuno = nb_dpu_set; dpuno < nb_dpu; dpuno++) {
-        char *file_name = make_mram_file_name(dpuno);
-        FILE *f = fopen(file_name, "w");
-        CHECK_FILE(f, file_name);
-        free(file_name);
-        xfer_file(vmis[dpuno].buffer, vmis[dpuno].size, f, xfer_write);
-        fclose(f);
-        free(vmis[dpuno].buffer);
+    if (nb_dpu_set != 0) {
+        free_dpu_stagings();
     }
 
-    free(tmp_mram);
+    if (spill_buckets != NULL) {
+        /* A single image at a time, to stay in the memory given with -M */
+        uint8_t *tmp_mram = (uint8_t *)malloc(spill_image_size);
+        assert(tmp_mram != NULL);
+        for (unsigned int dpuno = nb_dpu_set; dpuno < nb_dpu; dpuno++) {
+            finalize_spill_bucket(dpuno, tmp_mram);
+            write_mram_pack(&vmis_pack, dpuno, tmp_mram, 0, vmis[dpuno].size);
+        }
+        free(tmp_mram);
+        free(spill_buckets);
+        spill_buckets = NULL;
+    } else {
+        for_each_image(nb_dpu_set, nb_dpu, MRAM_PACK_THREAD, write_vmi_image, NULL);
+    }
+
+    close_mram_pack(&vmis_pack);
     free(vmis);
+
+    if (get_index_compressed()) {
+        /* The pack is compressed once complete, the images being written by pieces when spilled or helped by DPUs */
+        char *file_name = make_index_file_name(MRAM_PACK);
+        char *raw_file_name = make_index_file_name(MRAM_PACK ".raw");
+        assert(rename(file_name, raw_file_name) == 0);
+        convert_mram_pack(raw_file_name, file_name, true);
+        assert(unlink(raw_file_name) == 0);
+        free(raw_file_name);
+        free(file_name);
+    }
 }
 
 void write_vmi(unsigned int num_dpu, unsigned int num_ref, coords_and_nbr_t *coords_and_nbr)
@@ -142,9 +968,79 @@ void write_vmi(unsigned int num_dpu, unsigned int num_ref, coords_and_nbr_t *coo
     uint32_t offset = sizeof(coords_and_nbr_t) * num_ref;
     assert(offset < vmis[num_dpu].size);
     if (num_dpu < nb_dpu_set) {
-        DPU_ASSERT(dpu_copy_to_symbol(dpus[num_dpu], mram_symbol, offset, coords_and_nbr, sizeof(*coords_and_nbr)));
+        dpu_staging_t *staging = &dpu_stagings[num_dpu];
+        pthread_mutex_lock(&staging->mutex);
+        staging->records[staging->nb_records].num_ref = num_ref;
+        staging->records[staging->nb_records].coords_and_nbr = *coords_and_nbr;
+        if (++staging->nb_records == staging->max_records) {
+            flush_dpu_staging(num_dpu);
+        }
+        pthread_mutex_unlock(&staging->mutex);
+        return;
+    }
+    if (spill_buckets != NULL) {
+        spill_bucket_t *bucket = &spill_buckets[num_dpu];
+        pthread_mutex_lock(&bucket->mutex);
+        bucket->records[bucket->nb_records].num_ref = num_ref;
+        bucket->records[bucket->nb_records].coords_and_nbr = *coords_and_nbr;
+        if (++bucket->nb_records == spill_bucket_size) {
+            xfer_file((uint8_t *)bucket->records, spill_bucket_size * sizeof(vmi_record_t), bucket->f, xfer_write);
+            bucket->nb_records = 0;
+        }
+        pthread_mutex_unlock(&bucket->mutex);
         return;
     }
     coords_and_nbr_t *buffer = (coords_and_nbr_t *)&vmis[num_dpu].buffer[offset];
     memcpy(buffer, coords_and_nbr, sizeof(*coords_and_nbr));
 }
+
+void mram_move_chunks(unsigned int nb_dpu_src, unsigned int nb_dpu_dst, distribute_index_t *table,
+    const index_seed_t *src_chunks, const index_seed_t *dst_chunks, uint64_t nb_chunks)
+{
+    char *file_name = make_index_file_name(MRAM_PACK);
+    char *raw_file_name = make_index_file_name(MRAM_PACK ".raw");
+    char *new_file_name = make_index_file_name(MRAM_PACK ".new");
+
+    /* The chunks are moved between uncompressed images, a compressed pack being decompressed first and compressed again
+     * once rewritten */
+    mram_pack_t src_pack = open_mram_pack(file_name);
+    bool compressed = src_pack.flags & MRAM_PACK_COMPRESSED;
+    if (compressed) {
+        close_mram_pack(&src_pack);
+        convert_mram_pack(file_name, raw_file_name, false);
+        src_pack = open_mram_pack(raw_file_name);
+    }
+    assert(src_pack.nb_dpu == nb_dpu_src);
+    struct stat pack_stat;
+    assert(fstat(src_pack.fd, &pack_stat) == 0);
+    uint8_t *src_mrams = mmap(NULL, pack_stat.st_size, PROT_READ, MAP_PRIVATE, src_pack.fd, 0);
+    assert(src_mrams != MAP_FAILED);
+
+    /* The new pack is written next to the one being read, and replaces it once complete */
+    mram_pack_t dst_pack = create_table_mram_pack(new_file_name, nb_dpu_dst, table);
+
+    for (uint64_t each_chunk = 0; each_chunk < nb_chunks; each_chunk++) {
+        const index_seed_t *src = &src_chunks[each_chunk];
+        const index_seed_t *dst = &dst_chunks[each_chunk];
+        size_t size = src->nb_nbr * sizeof(coords_and_nbr_t);
+        size_t src_offset = src->offset * sizeof(coords_and_nbr_t);
+        assert(src->num_dpu < nb_dpu_src && src_offset + size <= src_pack.entries[src->num_dpu].size);
+        assert(dst->num_dpu < nb_dpu_dst && dst->nb_nbr == src->nb_nbr);
+        write_mram_pack(&dst_pack, dst->num_dpu, &src_mrams[src_pack.entries[src->num_dpu].offset + src_offset],
+            dst->offset * sizeof(coords_and_nbr_t), size);
+    }
+
+    munmap(src_mrams, pack_stat.st_size);
+    close_mram_pack(&src_pack);
+    close_mram_pack(&dst_pack);
+    if (compressed) {
+        assert(unlink(raw_file_name) == 0);
+        convert_mram_pack(new_file_name, file_name, true);
+        assert(unlink(new_file_name) == 0);
+    } else {
+        assert(rename(new_file_name, file_name) == 0);
+    }
+    free(new_file_name);
+    free(raw_file_name);
+    free(file_name);
+}
@@ -17,17 +17,32 @@
 
 #include <dpu.h>
 
+#include "common.h"
+#include "index.h"
 #include "parse_args.h"
 #include "upvc.h"
 
+/* The pre-filter only drops pairs when -N or -C is given, and the seeds are only capped when -m is given */
+#define DEFAULT_PREFILTER_MAX_N (SIZE_READ)
+#define DEFAULT_PREFILTER_MIN_COMPLEXITY (0)
+#define DEFAULT_MAX_SEED_OCCURRENCES (0)
+#define DEFAULT_MAX_CHUNK_COPIES (4)
+
 static char *prog_name = NULL;
 static char *input_path = NULL;
+static char *interleaved_input = NULL;
 static bool simulation_mode = false;
 static bool no_filter = false;
 static bool index_with_dpus = false;
+static bool index_compressed = false;
 static goal_t goal = goal_unknown;
 static unsigned int nb_dpu = DPU_ALLOCATE_ALL;
 static unsigned int nb_thread_for_simu = UINT_MAX;
+static unsigned int prefilter_max_n = UINT_MAX;
+static unsigned int prefilter_min_complexity = UINT_MAX;
+static unsigned int max_seed_occurrences = UINT_MAX;
+static unsigned int max_chunk_copies = UINT_MAX;
+static unsigned int index_max_memory = UINT_MAX;
 
 /**************************************************************************************/
 /**************************************************************************************/
@@ -35,15 +50,33 @@ static void usage()
 {
     ERROR_EXIT(ERR_USAGE,
         "\nusage: %s -i <input_prefix> -g <goal> [ -s [ -t <number_of_thread_for_dpu_simulation> ] | -n <number_of_dpus>] [ -d "
-        "]\n"
+        "] [ -p <interleaved_input> ] [ -N <max_n_per_read> ] [ -C <min_complexity_per_read> ]\n"
+        "       [ -m <max_seed_occurrences> ] [ -r <max_chunk_copies> ] [ -M <index_max_memory_in_MB> ] [ -z ]\n"
         "options:\n"
         "\t-i\tInput prefix that will be used to find the inputs files\n"
-        "\t-g\tGoal of the run - values=index|map\n"
+        "\t-p\tRead the pairs of reads from an interleaved FASTQ file or FIFO ('-' for the standard input) instead of\n"
+        "\t\t<input_prefix>_PE1.fastq and <input_prefix>_PE2.fastq (only when mapping or rebalancing)\n"
+        "\t-g\tGoal of the run - values=index|map|rebalance (distribute the index again between -n DPUs, by default as many\n"
+        "\t\tas it was created for, from the cost of mapping the reads of the inputs)|preload (keep the MRAM images of the\n"
+        "\t\tindex in shared memory for the next runs)\n"
         "\t-d\tTry to use Hardware DPU to help indexing\n"
         "\t-s\tSimulation mode (not compatible with -n)\n"
         "\t-t\tNumber of thread to use to simulate DPUs (only in simulation mode) (default: 1/2 of the threads of the system)\n"
-        "\t-n\tNumber of DPUs to use when not in simulation mode (default: use all available DPUs)\n",
-        prog_name);
+        "\t-n\tNumber of DPUs to use when not in simulation mode (default: use all available DPUs)\n"
+        "\t-N\tDrop the pairs with a read having more N than this before mapping them, e.g. %u for 10%% of the read\n"
+        "\t\t(default: %u, no pair dropped)\n"
+        "\t-C\tDrop the pairs with a read made of less distinct trinucleotides than this before mapping them, e.g. 8 to drop\n"
+        "\t\thomopolymers and short tandem repeats (default: %u, no pair dropped)\n"
+        "\t-m\tKeep the seeds occurring more than this in the reference genome out of the index, e.g. 16384, 0 to keep every\n"
+        "\t\tseed (only when indexing) (default: %u, every seed kept)\n"
+        "\t-r\tCopy the chunks of the index the most compared on up to this number of DPUs, from 1 (no copy) to %u (only\n"
+        "\t\twhen indexing) (default: %u)\n"
+        "\t-M\tKeep the MRAM images built in memory under this number of MB, spilling the neighbours of each DPU to a file\n"
+        "\t\tof the index folder when they do not fit, 0 for no limit (only when indexing) (default: 0)\n"
+        "\t-z\tCompress the MRAM images of the index, decompressed on several threads each time they are loaded (only\n"
+        "\t\twhen indexing)\n",
+        prog_name, SIZE_READ / 10, DEFAULT_PREFILTER_MAX_N, DEFAULT_PREFILTER_MIN_COMPLEXITY, DEFAULT_MAX_SEED_OCCURRENCES,
+        MAX_CHUNK_COPIES, DEFAULT_MAX_CHUNK_COPIES);
 }
 
 static void check_args()
@@ -65,9 +98,55 @@ static void check_args()
             usage();
         }
     } else if (index_with_dpus) {
-        ERROR("-d is not compatible with mapping");
+        ERROR("-d is only compatible with indexing");
+        usage();
+    } else if (index_compressed) {
+        ERROR("-z is only compatible with indexing");
+        usage();
+    }
+    if (goal == goal_rebalance && nb_dpu == 0) {
+        ERROR("cannot rebalance the index for 0 dpus");
+        usage();
+    }
+    if (goal == goal_index && interleaved_input != NULL) {
+        ERROR("-p is only compatible with mapping and rebalancing");
         usage();
     }
+    if (goal == goal_index && (prefilter_max_n != UINT_MAX || prefilter_min_complexity != UINT_MAX)) {
+        ERROR("-N and -C are only compatible with mapping and rebalancing");
+        usage();
+    }
+    if (goal != goal_index && max_seed_occurrences != UINT_MAX) {
+        ERROR("-m is only compatible with indexing");
+        usage();
+    }
+    if (goal != goal_index && max_chunk_copies != UINT_MAX) {
+        ERROR("-r is only compatible with indexing");
+        usage();
+    }
+    if (goal != goal_index && index_max_memory != UINT_MAX) {
+        ERROR("-M is only compatible with indexing");
+        usage();
+    }
+    if (max_chunk_copies != UINT_MAX && (max_chunk_copies == 0 || max_chunk_copies > MAX_CHUNK_COPIES)) {
+        ERROR("the maximum number of copies of a chunk must be between 1 and %u", MAX_CHUNK_COPIES);
+        usage();
+    }
+    if (max_chunk_copies == UINT_MAX) {
+        max_chunk_copies = DEFAULT_MAX_CHUNK_COPIES;
+    }
+    if (index_max_memory == UINT_MAX) {
+        index_max_memory = 0;
+    }
+    if (max_seed_occurrences == UINT_MAX) {
+        max_seed_occurrences = DEFAULT_MAX_SEED_OCCURRENCES;
+    }
+    if (prefilter_max_n == UINT_MAX) {
+        prefilter_max_n = DEFAULT_PREFILTER_MAX_N;
+    }
+    if (prefilter_min_complexity == UINT_MAX) {
+        prefilter_min_complexity = DEFAULT_PREFILTER_MIN_COMPLEXITY;
+    }
     if (simulation_mode && nb_thread_for_simu == UINT_MAX) {
         nb_thread_for_simu = get_nprocs() / 2;
     }
@@ -96,6 +175,21 @@ static void validate_inputs(const char *input_prefix)
 
 char *get_input_path() { return input_path; }
 
+/**************************************************************************************/
+/**************************************************************************************/
+static void validate_interleaved_input(const char *interleaved_input_path)
+{
+    if (interleaved_input != NULL) {
+        ERROR("interleaved input option has been entered more than once");
+        usage();
+    } else {
+        interleaved_input = strdup(interleaved_input_path);
+        assert(interleaved_input != NULL);
+    }
+}
+
+char *get_interleaved_input() { return interleaved_input; }
+
 /**************************************************************************************/
 /**************************************************************************************/
 static void validate_goal(const char *goal_str)
@@ -107,6 +201,10 @@ static void validate_goal(const char *goal_str)
         goal = goal_index;
     } else if (strcmp(goal_str, "map") == 0) {
         goal = goal_map;
+    } else if (strcmp(goal_str, "rebalance") == 0) {
+        goal = goal_rebalance;
+    } else if (strcmp(goal_str, "preload") == 0) {
+        goal = goal_preload;
     } else {
         ERROR("unknown goal value");
         usage();
@@ -146,6 +244,12 @@ static void validate_index_with_dpus_mode() { index_with_dpus = true; }
 
 bool get_index_with_dpus() { return index_with_dpus; }
 
+/**************************************************************************************/
+/**************************************************************************************/
+static void validate_index_compressed_mode() { index_compressed = true; }
+
+bool get_index_compressed() { return index_compressed; }
+
 /**************************************************************************************/
 /**************************************************************************************/
 static void validate_nb_thread_for_simu(const char *nb_thread_for_simu_str)
@@ -162,6 +266,71 @@ static void validate_nb_thread_for_simu(const char *nb_thread_for_simu_str)
 
 unsigned int get_nb_thread_for_simu() { return nb_thread_for_simu; }
 
+/**************************************************************************************/
+/**************************************************************************************/
+static void validate_prefilter_max_n(const char *max_n_str)
+{
+    if (prefilter_max_n != UINT_MAX) {
+        ERROR("maximum number of N per read option has been entered more than once");
+        usage();
+    }
+    prefilter_max_n = (unsigned int)atoi(max_n_str);
+}
+
+unsigned int get_prefilter_max_n() { return prefilter_max_n; }
+
+/**************************************************************************************/
+/**************************************************************************************/
+static void validate_prefilter_min_complexity(const char *min_complexity_str)
+{
+    if (prefilter_min_complexity != UINT_MAX) {
+        ERROR("minimum complexity per read option has been entered more than once");
+        usage();
+    }
+    prefilter_min_complexity = (unsigned int)atoi(min_complexity_str);
+}
+
+unsigned int get_prefilter_min_complexity() { return prefilter_min_complexity; }
+
+/**************************************************************************************/
+/**************************************************************************************/
+static void validate_max_seed_occurrences(const char *max_seed_occurrences_str)
+{
+    if (max_seed_occurrences != UINT_MAX) {
+        ERROR("maximum number of occurrences of a seed option has been entered more than once");
+        usage();
+    }
+    max_seed_occurrences = (unsigned int)atoi(max_seed_occurrences_str);
+}
+
+unsigned int get_max_seed_occurrences() { return max_seed_occurrences; }
+
+/**************************************************************************************/
+/**************************************************************************************/
+static void validate_max_chunk_copies(const char *max_chunk_copies_str)
+{
+    if (max_chunk_copies != UINT_MAX) {
+        ERROR("maximum number of copies of a chunk option has been entered more than once");
+        usage();
+    }
+    max_chunk_copies = (unsigned int)atoi(max_chunk_copies_str);
+}
+
+unsigned int get_max_chunk_copies() { return max_chunk_copies; }
+
+/**************************************************************************************/
+/**************************************************************************************/
+static void validate_index_max_memory(const char *index_max_memory_str)
+{
+    if (index_max_memory != UINT_MAX) {
+        ERROR("maximum memory of the index option has been entered more than once");
+        usage();
+    }
+    index_max_memory = (unsigned int)atoi(index_max_memory_str);
+}
+
+unsigned int get_index_max_memory() { return index_max_memory; }
+
 /**************************************************************************************/
 /**************************************************************************************/
 void validate_args(int argc, char **argv)
@@ -172,17 +341,23 @@ void validate_args(int argc, char **argv)
     prog_name = strdup(argv[0]);
     check_permission();
 
-    while ((opt = getopt(argc, argv, "dfsi:g:n:t:")) != -1) {
+    while ((opt = getopt(argc, argv, "dfszi:g:n:t:p:N:C:m:r:M:")) != -1) {
         switch (opt) {
         case 'd':
             validate_index_with_dpus_mode();
             break;
+        case 'z':
+            validate_index_compressed_mode();
+            break;
         case 't':
             validate_nb_thread_for_simu(optarg);
             break;
         case 'i':
             validate_inputs(optarg);
             break;
+        case 'p':
+            validate_interleaved_input(optarg);
+            break;
         case 'g':
             validate_goal(optarg);
             break;
@@ -195,6 +370,21 @@ void validate_args(int argc, char **argv)
         case 'f':
             validate_no_filter();
             break;
+        case 'N':
+            validate_prefilter_max_n(optarg);
+            break;
+        case 'C':
+            validate_prefilter_min_complexity(optarg);
+            break;
+        case 'm':
+            validate_max_seed_occurrences(optarg);
+            break;
+        case 'r':
+            validate_max_chunk_copies(optarg);
+            break;
+        case 'M':
+            validate_index_max_memory(optarg);
+            break;
         default:
             ERROR("unknown option");
             usage();
@@ -207,4 +397,5 @@ void free_args()
 {
     free(prog_name);
     free(input_path);
+    free(interleaved_input);
 }
@@ -0,0 +1,111 @@
+/**
+ * Copyright 2016-2019 - Dominique Lavenier & UPMEM
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "getread.h"
+#include "index.h"
+#include "parse_args.h"
+#include "prefilter.h"
+
+static prefilter_stats_t run_stats;
+
+bool prefilter_enabled() { return get_prefilter_max_n() < SIZE_READ || get_prefilter_min_complexity() > 1; }
+
+static unsigned int count_n(const uint8_t *read)
+{
+    unsigned int nb_n = 0;
+    for (unsigned int each_byte = 0; each_byte < SIZE_READ_N_MASK; each_byte++) {
+        nb_n += __builtin_popcount(read[SIZE_READ_PACKED + each_byte]);
+    }
+    return nb_n;
+}
+
+/**
+ * @brief Complexity of a read: the number of distinct trinucleotides it is made of (1 for a homopolymer, 2 or 3 for a
+ * dinucleotide repeat, around 60 for a random read). The N are not taken into account.
+ */
+static unsigned int read_complexity(const uint8_t *read)
+{
+    uint64_t trinucleotides = 0ULL;
+    unsigned int code = 0;
+    unsigned int nb_valid = 0;
+    for (unsigned int i = 0; i < SIZE_READ; i++) {
+        if (read_is_n(read, i)) {
+            nb_valid = 0;
+            continue;
+        }
+        code = ((code << 2) | read_get_nucleotide(read, i)) & 0x3f;
+        if (++nb_valid >= 3) {
+            trinucleotides |= 1ULL << code;
+        }
+    }
+    return __builtin_popcountll(trinucleotides);
+}
+
+static void count_avoided_requests(uint8_t *pair, prefilter_stats_t *stats)
+{
+    for (unsigned int each_read = 0; each_read < 4; each_read++) {
+        unsigned int seed_position, nb_chunks;
+        index_seed_t *seed = index_get(&pair[each_read * SIZE_READ_IN_BYTES], &seed_position, &nb_chunks);
+        for (unsigned int each_chunk = 0; each_chunk < nb_chunks; each_chunk += 1 + seed[each_chunk].nb_replicas) {
+            stats->nb_requests++;
+            stats->nb_comparisons += seed[each_chunk].nb_nbr;
+        }
+    }
+}
+
+unsigned int prefilter_pairs(uint8_t *reads, unsigned int nb_pairs, prefilter_stats_t *stats)
+{
+    const unsigned int max_n = get_prefilter_max_n();
+    const unsigned int min_complexity = get_prefilter_min_complexity();
+    const size_t pair_size = 4 * SIZE_READ_IN_BYTES;
+    unsigned int nb_kept = 0;
+
+    for (unsigned int each_pair = 0; each_pair < nb_pairs; each_pair++) {
+        uint8_t *pair = &reads[each_pair * pair_size];
+        /* Only the first read of each mate is checked, its reverse complement has the same N and complexity */
+        uint8_t *read = &pair[0 * SIZE_READ_IN_BYTES];
+        uint8_t *mate = &pair[2 * SIZE_READ_IN_BYTES];
+
+        stats->nb_pairs++;
+        if (count_n(read) > max_n || count_n(mate) > max_n) {
+            stats->nb_n_rich_pairs++;
+        } else if (read_complexity(read) < min_complexity || read_complexity(mate) < min_complexity) {
+            stats->nb_low_complexity_pairs++;
+        } else {
+            if (nb_kept != each_pair) {
+                memcpy(&reads[nb_kept * pair_size], pair, pair_size);
+            }
+            nb_kept++;
+            continue;
+        }
+        count_avoided_requests(pair, stats);
+    }
+    return nb_kept;
+}
+
+void prefilter_add_stats(const prefilter_stats_t *stats)
+{
+    run_stats.nb_pairs += stats->nb_pairs;
+    run_stats.nb_n_rich_pairs += stats->nb_n_rich_pairs;
+    run_stats.nb_low_complexity_pairs += stats->nb_low_complexity_pairs;
+    run_stats.nb_requests += stats->nb_requests;
+    run_stats.nb_comparisons += stats->nb_comparisons;
+}
+
+void prefilter_print_stats()
+{
+    if (run_stats.nb_pairs != 0) {
+        printf("prefilter:\n"
+               "\tdropped: %lu pairs out of %lu (%lu N-rich, %lu low complexity)\n"
+               "\tavoided: %lu requests, %lu DPU comparisons\n",
+            run_stats.nb_n_rich_pairs + run_stats.nb_low_complexity_pairs, run_stats.nb_pairs, run_stats.nb_n_rich_pairs,
+            run_stats.nb_low_complexity_pairs, run_stats.nb_requests, run_stats.nb_comparisons);
+    }
+    memset(&run_stats, 0, sizeof(run_stats));
+}
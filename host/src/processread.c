@@ -72,7 +72,7 @@ static void DPD_compute(int s1, int s2, int *Dij, int Dijm, int Dimj, int Dimjm,
     }
 }
 
-int DPD(int8_t *s1, int8_t *s2, backtrack_t *backtrack, int size_neighbour_in_symbols)
+int DPD(int8_t *s1, uint8_t *s2, backtrack_t *backtrack, int size_neighbour_in_symbols)
 {
     int matrix_size = size_neighbour_in_symbols + 1;
     int diagonal = (NB_DIAG / 2) + 1;
@@ -101,7 +101,7 @@ int DPD(int8_t *s1, int8_t *s2, backtrack_t *backtrack, int size_neighbour_in_sy
 
     for (int i = 1; i < diagonal; i++) {
         for (int j = 1; j < i + diagonal; j++) {
-            DPD_compute(s1[i - 1], s2[j - 1], &D[i][j], D[i][j - 1], D[i - 1][j], D[i - 1][j - 1], &P[i][j], P[i][j - 1],
+            DPD_compute(s1[i - 1], read_get_nucleotide(s2, j - 1), &D[i][j], D[i][j - 1], D[i - 1][j], D[i - 1][j - 1], &P[i][j], P[i][j - 1],
                 &Q[i][j], Q[i - 1][j], &X[i][j]);
         }
         Q[i][i + diagonal] = PQD_INIT_VAL;
@@ -111,7 +111,7 @@ int DPD(int8_t *s1, int8_t *s2, backtrack_t *backtrack, int size_neighbour_in_sy
         P[i][i - diagonal] = PQD_INIT_VAL;
         D[i][i - diagonal] = PQD_INIT_VAL;
         for (int j = i - diagonal + 1; j < i + diagonal; j++) {
-            DPD_compute(s1[i - 1], s2[j - 1], &D[i][j], D[i][j - 1], D[i - 1][j], D[i - 1][j - 1], &P[i][j], P[i][j - 1],
+            DPD_compute(s1[i - 1], read_get_nucleotide(s2, j - 1), &D[i][j], D[i][j - 1], D[i - 1][j], D[i - 1][j - 1], &P[i][j], P[i][j - 1],
                 &Q[i][j], Q[i - 1][j], &X[i][j]);
         }
         Q[i][i + diagonal] = PQD_INIT_VAL;
@@ -122,7 +122,7 @@ int DPD(int8_t *s1, int8_t *s2, backtrack_t *backtrack, int size_neighbour_in_sy
         P[i][i - diagonal] = PQD_INIT_VAL;
         D[i][i - diagonal] = PQD_INIT_VAL;
         for (int j = i - diagonal + 1; j < matrix_size; j++) {
-            DPD_compute(s1[i - 1], s2[j - 1], &D[i][j], D[i][j - 1], D[i - 1][j], D[i - 1][j - 1], &P[i][j], P[i][j - 1],
+            DPD_compute(s1[i - 1], read_get_nucleotide(s2, j - 1), &D[i][j], D[i][j - 1], D[i - 1][j], D[i - 1][j - 1], &P[i][j], P[i][j - 1],
                 &Q[i][j], Q[i - 1][j], &X[i][j]);
         }
         if (D[i][matrix_size - 1] < min_score) {
@@ -192,7 +192,7 @@ int DPD(int8_t *s1, int8_t *s2, backtrack_t *backtrack, int size_neighbour_in_sy
  * The code is return in "code" as a table of int8_t
  */
 
-static int code_alignment(uint8_t *code, int score, int8_t *gen, int8_t *read, unsigned size_neighbour_in_symbols)
+static int code_alignment(uint8_t *code, int score, int8_t *gen, uint8_t *read, unsigned size_neighbour_in_symbols)
 {
     int code_idx, computed_score, backtrack_idx;
     int size_read = SIZE_READ;
@@ -204,15 +204,15 @@ static int code_alignment(uint8_t *code, int score, int8_t *gen, int8_t *read, u
         return 1;
     }
 
-    /* First, looking for subsititution only */
+    /* First, looking for subsititution only, from the beginning of the read (see score_seed_prefix) */
     code_idx = 0;
     computed_score = 0;
-    for (int i = SIZE_SEED; i < size_neighbour + SIZE_SEED; i++) {
-        if ((gen[i] & 3) != read[i]) {
+    for (int i = 0; i < size_neighbour + SIZE_SEED; i++) {
+        if ((gen[i] & 3) != read_get_nucleotide(read, i)) {
             computed_score += COST_SUB;
             code[code_idx++] = CODE_SUB;
             code[code_idx++] = i;
-            code[code_idx++] = read[i];
+            code[code_idx++] = read_get_nucleotide(read, i);
             if (computed_score > score) {
                 break;
             }
@@ -235,7 +235,7 @@ static int code_alignment(uint8_t *code, int score, int8_t *gen, int8_t *read, u
         if (backtrak[backtrack_idx].type == CODE_SUB) {
             code[code_idx++] = CODE_SUB;
             code[code_idx++] = backtrak[backtrack_idx].jx - 1;
-            code[code_idx++] = read[backtrak[backtrack_idx].jx - 1];
+            code[code_idx++] = read_get_nucleotide(read, backtrak[backtrack_idx].jx - 1);
             backtrack_idx--;
         } else {
             if (backtrak[backtrack_idx].type == CODE_DEL) {
@@ -252,10 +252,10 @@ static int code_alignment(uint8_t *code, int score, int8_t *gen, int8_t *read, u
                 int backtrack_ix = backtrak[backtrack_idx].ix;
                 code[code_idx++] = CODE_INS;
                 code[code_idx++] = backtrak[backtrack_idx].jx - 1;
-                code[code_idx++] = read[backtrak[backtrack_idx].jx];
+                code[code_idx++] = read_get_nucleotide(read, backtrak[backtrack_idx].jx);
                 backtrack_idx--;
                 while ((backtrak[backtrack_idx].type == CODE_INS) && (backtrack_ix == backtrak[backtrack_idx].ix)) {
-                    code[code_idx++] = read[backtrak[backtrack_idx].jx];
+                    code[code_idx++] = read_get_nucleotide(read, backtrak[backtrack_idx].jx);
                     backtrack_idx--;
                 }
             }
@@ -266,17 +266,17 @@ static int code_alignment(uint8_t *code, int score, int8_t *gen, int8_t *read, u
 }
 
 static void set_variant(
-    dpu_result_out_t result_match, genome_t *ref_genome, int8_t *reads_buffer, unsigned int size_neighbour_in_symbols)
+    dpu_result_out_t result_match, genome_t *ref_genome, uint8_t *reads_buffer, unsigned int size_neighbour_in_symbols)
 {
     uint32_t code_result_idx;
     uint8_t code_result_tab[256];
-    int8_t *read;
+    uint8_t *read;
     char nucleotide[4] = { 'A', 'C', 'T', 'G' };
     uint64_t genome_pos = ref_genome->pt_seq[result_match.coord.seq_nr] + result_match.coord.seed_nr;
     int size_read = SIZE_READ;
 
     /* Get the differences betweend the read and the sequence of the reference genome that match */
-    read = &reads_buffer[result_match.num * size_read];
+    read = &reads_buffer[result_match.num * SIZE_READ_IN_BYTES];
     code_alignment(code_result_tab, result_match.score, &ref_genome->data[genome_pos], read, size_neighbour_in_symbols);
     if (code_result_tab[0] == CODE_ERR)
         return;
@@ -314,7 +314,7 @@ static void set_variant(
                 code_result_idx++;
             }
 
-            while (ref_genome->data[ps_var_genome] == read[ps_var_read]) {
+            while (ps_var_read >= 0 && ref_genome->data[ps_var_genome] == read_get_nucleotide(read, ps_var_read)) {
                 ps_var_genome--;
                 ps_var_read--;
                 pos_variant_genome--;
@@ -324,7 +324,7 @@ static void set_variant(
             newvar->ref[ref_pos++] = nucleotide[ref_genome->data[pos_variant_genome] & 3];
 
             while (pos_variant_read <= ps_var_read) {
-                newvar->alt[alt_pos++] = nucleotide[read[pos_variant_read] & 3];
+                newvar->alt[alt_pos++] = nucleotide[read_get_nucleotide(read, pos_variant_read)];
                 if (alt_pos >= MAX_SIZE_ALLELE - 1) {
                     free(newvar);
                     return;
@@ -342,7 +342,7 @@ static void set_variant(
                 code_result_idx++;
             }
 
-            while (ref_genome->data[ps_var_genome] == read[ps_var_read]) {
+            while (ps_var_read >= 0 && ref_genome->data[ps_var_genome] == read_get_nucleotide(read, ps_var_read)) {
                 ps_var_read--;
                 ps_var_genome--;
                 pos_variant_genome--;
@@ -369,26 +369,26 @@ static void set_variant(
 }
 
 static pthread_mutex_t non_mapped_mutex;
-static void add_to_non_mapped_read(int numread, int round, FILE *fpe1, FILE *fpe2, int8_t *reads_buffer)
+static void add_to_non_mapped_read(int numread, int round, FILE *fpe1, FILE *fpe2, uint8_t *reads_buffer)
 {
     if (fpe1 == NULL || fpe2 == NULL)
         return;
     pthread_mutex_lock(&non_mapped_mutex);
     char nucleotide[4] = { 'A', 'C', 'T', 'G' };
     int size_read = SIZE_READ;
-    int8_t *read = &reads_buffer[numread * size_read];
+    uint8_t *read = &reads_buffer[numread * SIZE_READ_IN_BYTES];
     fprintf(fpe1, ">>%d\n", SIZE_SEED * (round + 1));
     for (int j = SIZE_SEED; j < size_read; j++) {
-        fprintf(fpe1, "%c", nucleotide[read[j] & 3]);
+        fprintf(fpe1, "%c", read_is_n(read, j) ? 'N' : nucleotide[read_get_nucleotide(read, j)]);
     }
     for (int j = 0; j < SIZE_SEED; j++) {
         fprintf(fpe1, "A");
     }
     fprintf(fpe1, "\n");
-    read = &reads_buffer[(numread + 2) * size_read];
+    read = &reads_buffer[(numread + 2) * SIZE_READ_IN_BYTES];
     fprintf(fpe2, ">>%d\n", SIZE_SEED * (round + 1));
     for (int j = SIZE_SEED; j < size_read; j++) {
-        fprintf(fpe2, "%c", nucleotide[read[j] & 3]);
+        fprintf(fpe2, "%c", read_is_n(read, j) ? 'N' : nucleotide[read_get_nucleotide(read, j)]);
     }
     for (int j = 0; j < SIZE_SEED; j++) {
         fprintf(fpe2, "A");
@@ -417,7 +417,7 @@ typedef struct {
     unsigned int nb_match;
     dpu_result_out_t *result_tab;
     int round;
-    int8_t *reads_buffer;
+    uint8_t *reads_buffer;
     genome_t *ref_genome;
     FILE *fpe1;
     FILE *fpe2;
@@ -427,12 +427,30 @@ static uint64_t nr_reads_total = 0ULL;
 static uint64_t nr_reads_non_mapped = 0ULL;
 static pthread_mutex_t nr_reads_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/**
+ * @brief Add to the score of "result" the substitutions on the first SIZE_SEED nucleotides of its read.
+ *
+ * The DPUs compare the neighbour following the seed of a read, which is not necessarily at its beginning: the nucleotides
+ * before the seed are not in their score (see DELTA_SEED_POSITION). The seed itself matching the reference, this makes
+ * the scores of a read cover the same nucleotides whatever the position of its seed.
+ */
+static void score_seed_prefix(dpu_result_out_t *result, genome_t *ref_genome, uint8_t *reads_buffer)
+{
+    uint8_t *read = &reads_buffer[result->num * SIZE_READ_IN_BYTES];
+    int8_t *gen = &ref_genome->data[ref_genome->pt_seq[result->coord.seq_nr] + result->coord.seed_nr];
+    for (int i = 0; i < SIZE_SEED; i++) {
+        if ((gen[i] & 3) != read_get_nucleotide(read, i)) {
+            result->score += COST_SUB;
+        }
+    }
+}
+
 static void do_process_read(process_read_arg_t *arg)
 {
     const unsigned int nb_match = arg->nb_match;
     dpu_result_out_t *result_tab = arg->result_tab;
     int round = arg->round;
-    int8_t *reads_buffer = arg->reads_buffer;
+    uint8_t *reads_buffer = arg->reads_buffer;
     genome_t *ref_genome = arg->ref_genome;
     FILE *fpe1 = arg->fpe1;
     FILE *fpe2 = arg->fpe2;
@@ -464,6 +482,9 @@ static void do_process_read(process_read_arg_t *arg)
             j++;
         }
         release_curr_match(j);
+        for (unsigned int x = i; x < j; x++) {
+            score_seed_prefix(&result_tab[x], ref_genome, reads_buffer);
+        }
 
         // i = start index in result_tab
         // j = stop index in result_tab
@@ -541,7 +562,7 @@ static bool stop_threads = false;
 
 void process_read(FILE *fpe1, FILE *fpe2, int round, unsigned int pass_id)
 {
-    int8_t *reads_buffer = get_reads_buffer(pass_id);
+    uint8_t *reads_buffer = get_reads_buffer(pass_id);
     acc_results_t acc_res = accumulate_get_result(pass_id);
 
     curr_match = 0;
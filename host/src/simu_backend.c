@@ -145,17 +145,17 @@ static int translation_table[256] = { 0, 10, 10, 10, 10, 20, 20, 20, 10, 20, 20,
  * @brief Optimized version of ODPD (if no INDELS)
  * If it detects INDELS, return -1. In this case we will need the run the full ODPD.
  */
-static int noDP(int8_t *s1, int8_t *s2, int max_score)
+static int noDP(int8_t *s1, int8_t *s2, int max_score, int delta)
 {
     int score = 0;
     int size_neighbour = SIZE_NEIGHBOUR_IN_BYTES;
-    for (int i = 0; i < size_neighbour - delta_neighbour; i++) {
+    for (int i = 0; i < size_neighbour - delta; i++) {
         int s_xor = ((int)(s1[i] ^ s2[i])) & 0xFF;
         int s_translated = translation_table[s_xor];
         if (s_translated > COST_SUB) {
             int j = i + 1;
             /* INDELS detection */
-            if (j < size_neighbour - delta_neighbour - 3) {
+            if (j < size_neighbour - delta - 3) {
                 int s1_val = ((int *)(&s1[j]))[0];
                 int s2_val = ((int *)(&s2[j]))[0];
                 if (((s1_val ^ (s2_val >> 2)) & 0x3FFFFFFF) == 0) {
@@ -197,7 +197,6 @@ static void align_on_dpu(unsigned int dpu_offset, unsigned rank_id, int pass_id)
     int numdpu = dpu_offset + rank_id;
     if (numdpu >= (int)index_get_nb_dpu())
         return;
-    int size_neighbour_in_symbols = SIZE_IN_SYMBOLS(delta_neighbour);
     dispatch_request_t *requests = dispatch_get(numdpu, pass_id);
     acc_results_t *acc_res = accumulate_get_buffer(rank_id, pass_id);
 
@@ -206,11 +205,18 @@ static void align_on_dpu(unsigned int dpu_offset, unsigned rank_id, int pass_id)
         int min = MAX_SCORE;
         int nb_map_start = nb_map;
         int8_t *curr_read = (int8_t *)&curr_request->nbr[0];
+        unsigned int seed_position = curr_request->seed_position;
+        int delta = delta_neighbour + DELTA_SEED_POSITION(seed_position);
+        int size_neighbour_in_symbols = SIZE_IN_SYMBOLS(delta);
         for (unsigned int nb_neighbour = 0; nb_neighbour < curr_request->count; nb_neighbour++) {
             coords_and_nbr_t *coord_and_nbr = &(mrams[rank_id][curr_request->offset + nb_neighbour]);
             int8_t *curr_nbr = (int8_t *)&coord_and_nbr->nbr[0];
 
-            int score = noDP(curr_read, curr_nbr, min);
+            /* The read would begin before the reference sequence */
+            if (coord_and_nbr->coord.seed_nr < seed_position)
+                continue;
+
+            int score = noDP(curr_read, curr_nbr, min, delta);
             if (score == -1) {
                 score = ODPD(curr_read, curr_nbr, min, size_neighbour_in_symbols);
             }
@@ -229,6 +235,7 @@ static void align_on_dpu(unsigned int dpu_offset, unsigned rank_id, int pass_id)
             dpu_result_out_t *result = &acc_res->results[nb_map++];
             result->num = curr_request->num;
             result->coord = coord_and_nbr->coord;
+            result->coord.seed_nr -= seed_position;
             result->score = score;
         }
     }
@@ -295,7 +302,7 @@ void free_backend_simulation()
     {
         int ret = pthread_join(tids[each_dpu], NULL);
         assert(ret == 0);
-        free(mrams[each_dpu]);
+        mram_free((uint8_t *)mrams[each_dpu]);
     }
 
     free(tids);
@@ -304,14 +311,16 @@ void free_backend_simulation()
 
 void load_mram_simulation(unsigned int dpu_offset, __attribute__((unused)) int _delta_neighbour)
 {
+    unsigned int dpu_ids[get_nb_thread_for_simu()];
+    size_t mram_sizes[get_nb_thread_for_simu()];
     FOREACH_THREAD(each_dpu)
     {
-        unsigned int dpu_id = dpu_offset + each_dpu;
-        if (dpu_id >= index_get_nb_dpu())
-            return;
-        free(mrams[each_dpu]);
-        mram_load((uint8_t **)&mrams[each_dpu], dpu_id);
+        dpu_ids[each_dpu] = dpu_offset + each_dpu;
+        if (dpu_ids[each_dpu] < index_get_nb_dpu()) {
+            mram_free((uint8_t *)mrams[each_dpu]);
+        }
     }
+    mram_load_all(get_nb_thread_for_simu(), dpu_ids, (uint8_t **)mrams, mram_sizes);
 }
 
 void wait_dpu_simulation() { return; }
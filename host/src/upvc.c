@@ -3,6 +3,8 @@
  */
 
 #define _POSIX_C_SOURCE 200809L
+#include <libgen.h>
+#include <limits.h>
 #include <semaphore.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,6 +18,7 @@
 #include "genome.h"
 #include "getread.h"
 #include "index.h"
+#include "mram_dpu.h"
 #include "parse_args.h"
 #include "processread.h"
 #include "simu_backend.h"
@@ -24,6 +27,8 @@
 
 #include "backends_functions.h"
 
+#include <dpu.h>
+
 unsigned int nb_dpus_per_run;
 
 static backends_functions_t backends_functions;
@@ -46,12 +51,11 @@ void *thread_get_reads(__attribute__((unused)) void *arg)
         unsigned int each_pass = 0;
         do {
             sem_wait(&accprocess_to_getreads_sem);
-            get_reads(fipe1, fipe2, each_pass);
+            get_reads(each_pass);
             sem_post(&getreads_to_dispatch_sem);
         } while (get_reads_in_buffer(each_pass++) != 0);
 
-        fseek(fipe1, 0, SEEK_SET);
-        fseek(fipe2, 0, SEEK_SET);
+        get_reads_rewind();
 
         FOR(NB_READS_BUFFER) { sem_wait(&accprocess_to_getreads_sem); }
     }
@@ -159,29 +163,67 @@ void *thread_process(__attribute__((unused)) void *arg)
     return NULL;
 }
 
-static void exec_round()
+/**
+ * @brief Open "<prefix>_<pe>.fastq", or "<prefix>_<pe>.fastq.gz" if it does not exist (NULL if none of them can be opened).
+ */
+static FILE *try_open_input(const char *input_prefix, const char *pe, char *filename)
+{
+    sprintf(filename, "%s_%s.fastq", input_prefix, pe);
+    FILE *f = fopen(filename, "r");
+    if (f == NULL && errno == ENOENT) {
+        sprintf(filename, "%s_%s.fastq.gz", input_prefix, pe);
+        f = fopen(filename, "r");
+    }
+    return f;
+}
+
+static FILE *open_input(const char *input_prefix, const char *pe, char *filename)
+{
+    FILE *f = try_open_input(input_prefix, pe, filename);
+    CHECK_FILE(f, filename);
+    return f;
+}
+
+static void open_inputs()
 {
     char filename[FILENAME_MAX];
     char *input_prefix = get_input_path();
-    static unsigned int max_nb_pass;
 
-    if (round == 0) {
-        size_t read_size1, read_size2, nb_read1, nb_read2;
+    if (get_interleaved_input() != NULL) {
+        /* Both reads of the pairs come from the same stream, which is read once (see get_reads_init) */
+        char *interleaved_input = get_interleaved_input();
+        fipe1 = (strcmp(interleaved_input, "-") == 0) ? stdin : fopen(interleaved_input, "r");
+        CHECK_FILE(fipe1, interleaved_input);
+        fipe2 = fipe1;
+    } else {
+        size_t read_size1, read_size2;
 
-        sprintf(filename, "%s_PE1.fastq", input_prefix);
-        fipe1 = fopen(filename, "r");
-        CHECK_FILE(fipe1, filename);
-        assert(get_input_info(fipe1, &read_size1, &nb_read1) == 0);
+        fipe1 = open_input(input_prefix, "PE1", filename);
+        assert(get_input_info(fipe1, &read_size1) == 0);
         assert(read_size1 == SIZE_READ);
 
-        sprintf(filename, "%s_PE2.fastq", input_prefix);
-        fipe2 = fopen(filename, "r");
-        CHECK_FILE(fipe2, filename);
-        assert(get_input_info(fipe2, &read_size2, &nb_read2) == 0);
+        fipe2 = open_input(input_prefix, "PE2", filename);
+        assert(get_input_info(fipe2, &read_size2) == 0);
         assert(read_size2 == SIZE_READ);
+    }
+}
+
+static void close_inputs()
+{
+    fclose(fipe1);
+    if (fipe2 != fipe1) {
+        fclose(fipe2);
+    }
+}
 
-        assert(nb_read1 == nb_read2);
-        max_nb_pass = (unsigned int)(nb_read1 * 2 + nb_read2 * 2 + MAX_READS_BUFFER - 1) / MAX_READS_BUFFER;
+static void exec_round()
+{
+    char filename[FILENAME_MAX];
+    char *input_prefix = get_input_path();
+    static unsigned int max_nb_pass;
+
+    if (round == 0) {
+        open_inputs();
     } else {
         fipe1 = fope1;
         fipe2 = fope2;
@@ -201,6 +243,10 @@ static void exec_round()
         assert(unlink(filename) == 0);
     }
 
+    get_reads_init(fipe1, fipe2, index_get_nb_dpu() > nb_dpus_per_run);
+    if (round == 0) {
+        max_nb_pass = get_reads_nb_pass();
+    }
     accumulate_init(max_nb_pass);
 
     pthread_t tid_get_reads;
@@ -266,9 +312,8 @@ static void exec_round()
     assert(ret == 0);
 
     accumulate_free();
-
-    fclose(fipe1);
-    fclose(fipe2);
+    get_reads_free();
+    close_inputs();
 }
 
 static void do_mapping()
@@ -293,6 +338,37 @@ static void do_mapping()
     backends_functions.free_backend();
 }
 
+/**
+ * @brief Distribute the index again from the requests the reads of the inputs are dispatched as.
+ */
+static void do_rebalance()
+{
+    double start_time = my_clock();
+    printf("Counting the requests of the reads on the chunks of the index\n");
+    uint32_t *chunk_hits = (uint32_t *)calloc(index_get_nb_chunks(), sizeof(uint32_t));
+    assert(chunk_hits != NULL);
+    uint64_t nb_reads = 0;
+
+    open_inputs();
+    get_reads_init(fipe1, fipe2, false);
+    for (unsigned int each_pass = 0;; each_pass++) {
+        get_reads(each_pass);
+        if (get_reads_in_buffer(each_pass) == 0) {
+            break;
+        }
+        index_count_hits(get_reads_buffer(each_pass), get_reads_in_buffer(each_pass), chunk_hits);
+        nb_reads += get_reads_in_buffer(each_pass);
+    }
+    get_reads_free();
+    close_inputs();
+    printf("\tnb_pairs: %lu\n"
+           "\ttime: %lf s\n",
+        nb_reads / 4, my_clock() - start_time);
+
+    index_rebalance(chunk_hits, get_nb_dpu() != DPU_ALLOCATE_ALL ? get_nb_dpu() : index_get_nb_dpu());
+    free(chunk_hits);
+}
+
 static void print_time()
 {
     time_t timer;
@@ -306,10 +382,54 @@ static void print_time()
     printf("upvc started at: %s\n", time_buf);
 }
 
+/**
+ * @brief Get the size of the reads of the inputs, or the size of the reads of the index when they are streamed
+ * (0 if it is not known).
+ */
+static unsigned int get_inputs_read_size()
+{
+    char filename[FILENAME_MAX];
+    size_t read_size;
+
+    if (get_interleaved_input() != NULL || get_goal() == goal_preload) {
+        return index_get_size_read();
+    }
+    FILE *f = try_open_input(get_input_path(), "PE1", filename);
+    if (f == NULL) {
+        return 0;
+    }
+    int ret = get_input_info(f, &read_size);
+    fclose(f);
+    return ret == 0 ? read_size : 0;
+}
+
+/**
+ * @brief Replace the process by the variant of upvc built for reads of "read_size" nucleotides, which is next to this one.
+ */
+static void exec_read_size_variant(unsigned int read_size, char *argv[])
+{
+    char exe_path[PATH_MAX];
+    char variant_path[PATH_MAX + 32];
+
+    ssize_t exe_path_len = readlink("/proc/self/exe", exe_path, sizeof(exe_path) - 1);
+    assert(exe_path_len > 0);
+    exe_path[exe_path_len] = '\0';
+    sprintf(variant_path, "%s/upvc_%u", dirname(exe_path), read_size);
+
+    execv(variant_path, argv);
+    ERROR_EXIT(ERR_READ_SIZE_NOT_SUPPORTED, "Reads of %u nucleotides are not supported by this build of upvc ('%s': %s)",
+        read_size, variant_path, strerror(errno));
+}
+
 int main(int argc, char *argv[])
 {
     validate_args(argc, argv);
 
+    unsigned int read_size = get_inputs_read_size();
+    if (read_size != 0 && read_size != SIZE_READ) {
+        exec_read_size_variant(read_size, argv);
+    }
+
     printf("%s\n", VERSION);
     print_time();
 
@@ -345,6 +465,13 @@ int main(int argc, char *argv[])
         index_load();
         do_mapping();
         break;
+    case goal_rebalance:
+        index_load();
+        do_rebalance();
+        break;
+    case goal_preload:
+        mram_preload();
+        break;
     case goal_unknown:
     default:
         ERROR_EXIT(ERR_NO_GOAL_DEFINED, "goal has not been specified!");
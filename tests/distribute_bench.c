@@ -0,0 +1,155 @@
+/**
+ * Benchmark of the distribution of the index between the DPUs (host/src/distribute.c).
+ *
+ * The chunks of a synthetic index (Zipf-distributed seed occurrences, sorted by decreasing number of occurrences as in
+ * index_create) are distributed between 128, 2560 and 10240 DPUs with the heap, and with the sorted list it replaces.
+ * Both must give every chunk to the same DPU at the same offset.
+ *
+ * usage: distribute_bench [<number_of_chunks>]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/queue.h>
+#include <time.h>
+
+#include "distribute.h"
+
+#define MAX_SIZE_IDX_SEED (500)
+#define DEFAULT_NB_CHUNKS (1000000)
+
+typedef struct {
+    uint32_t nb_nbr;
+    uint32_t nb_occurrences;
+    uint32_t offset;
+    uint32_t dpu_id;
+} chunk_t;
+
+static double my_clock()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Chunks of the seeds of ranks 1, 2, ... occurring max_occurrences / rank times, split as in init_index_seed.
+ */
+static chunk_t *create_chunks(unsigned int nb_chunks)
+{
+    const uint32_t max_occurrences = 1000000;
+    chunk_t *chunks = (chunk_t *)malloc(nb_chunks * sizeof(chunk_t));
+    assert(chunks != NULL);
+
+    unsigned int each_chunk = 0;
+    for (uint32_t rank = 1; each_chunk < nb_chunks; rank++) {
+        uint32_t nb_occurrences = max_occurrences / rank + 1;
+        uint32_t nb_index_needed = (nb_occurrences + MAX_SIZE_IDX_SEED - 1) / MAX_SIZE_IDX_SEED;
+        uint32_t nb_neighbour_per_index = (nb_occurrences + nb_index_needed - 1) / nb_index_needed;
+        for (uint32_t j = 0; j < nb_index_needed && each_chunk < nb_chunks; j++, each_chunk++) {
+            chunks[each_chunk].nb_nbr
+                = (j == 0) ? nb_occurrences - (nb_index_needed - 1) * nb_neighbour_per_index : nb_neighbour_per_index;
+            chunks[each_chunk].nb_occurrences = nb_occurrences;
+        }
+    }
+    return chunks;
+}
+
+typedef struct list_dpu {
+    uint64_t workload;
+    uint32_t size;
+    uint32_t dpu_id;
+    TAILQ_ENTRY(list_dpu) entries;
+} list_dpu_t;
+TAILQ_HEAD(list_dpu_head, list_dpu);
+
+/**
+ * @brief Distribution with a list of the DPUs sorted by decreasing workload, as it used to be done in index_create.
+ */
+static double distribute_with_list(chunk_t *chunks, unsigned int nb_chunks, unsigned int nb_dpu)
+{
+    double start_time = my_clock();
+    list_dpu_t *table = (list_dpu_t *)calloc(nb_dpu, sizeof(list_dpu_t));
+    assert(table != NULL);
+    struct list_dpu_head head = TAILQ_HEAD_INITIALIZER(head);
+
+    for (unsigned int i = 0; i < nb_dpu; i++) {
+        table[i].dpu_id = i;
+        TAILQ_INSERT_TAIL(&head, &table[i], entries);
+    }
+
+    for (unsigned int i = 0; i < nb_chunks; i++) {
+        list_dpu_t *dpu = TAILQ_LAST(&head, list_dpu_head);
+        TAILQ_REMOVE(&head, dpu, entries);
+        chunks[i].offset = dpu->size;
+        chunks[i].dpu_id = dpu->dpu_id;
+        dpu->size += chunks[i].nb_nbr;
+        dpu->workload += (uint64_t)chunks[i].nb_nbr * (uint64_t)chunks[i].nb_occurrences;
+
+        list_dpu_t *dpu_cmp;
+        bool dpu_inserted = false;
+        TAILQ_FOREACH(dpu_cmp, &head, entries)
+        {
+            if (dpu->workload >= dpu_cmp->workload) {
+                TAILQ_INSERT_BEFORE(dpu_cmp, dpu, entries);
+                dpu_inserted = true;
+                break;
+            }
+        }
+        if (!dpu_inserted) {
+            TAILQ_INSERT_HEAD(&head, dpu, entries);
+        }
+    }
+
+    free(table);
+    return my_clock() - start_time;
+}
+
+/**
+ * @brief Distribution with the heap of host/src/distribute.c, checked against the one of the list.
+ */
+static double distribute_with_heap(chunk_t *chunks, unsigned int nb_chunks, unsigned int nb_dpu)
+{
+    double start_time = my_clock();
+    distribute_index_t *table = (distribute_index_t *)calloc(nb_dpu, sizeof(distribute_index_t));
+    assert(table != NULL);
+    distribute_init(table, nb_dpu);
+
+    unsigned int nb_differences = 0;
+    for (unsigned int i = 0; i < nb_chunks; i++) {
+        uint32_t offset;
+        distribute_index_t *dpu
+            = distribute_chunk(chunks[i].nb_nbr, (uint64_t)chunks[i].nb_nbr * (uint64_t)chunks[i].nb_occurrences, &offset);
+        if (dpu->dpu_id != chunks[i].dpu_id || offset != chunks[i].offset) {
+            nb_differences++;
+        }
+    }
+
+    distribute_free();
+    free(table);
+    double time = my_clock() - start_time;
+    if (nb_differences != 0) {
+        fprintf(stderr, "%u chunks distributed differently with %u DPUs\n", nb_differences, nb_dpu);
+        exit(1);
+    }
+    return time;
+}
+
+int main(int argc, char **argv)
+{
+    const unsigned int nb_dpus[] = { 128, 2560, 10240 };
+    unsigned int nb_chunks = argc > 1 ? (unsigned int)atoi(argv[1]) : DEFAULT_NB_CHUNKS;
+    chunk_t *chunks = create_chunks(nb_chunks);
+
+    printf("nb_chunks: %u\n", nb_chunks);
+    for (unsigned int i = 0; i < sizeof(nb_dpus) / sizeof(nb_dpus[0]); i++) {
+        double list_time = distribute_with_list(chunks, nb_chunks, nb_dpus[i]);
+        double heap_time = distribute_with_heap(chunks, nb_chunks, nb_dpus[i]);
+        printf("%u DPUs: list %lf s, heap %lf s (x%.1f)\n", nb_dpus[i], list_time, heap_time, list_time / heap_time);
+    }
+
+    free(chunks);
+    return 0;
+}